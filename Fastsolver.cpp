@@ -1,8 +1,20 @@
 // sudoku_fixed.cpp
 // C++11/C++17 compatible single-file Sudoku solver + generator
-// Compile: g++ -std=c++11 sudoku_fixed.cpp -O2 -o sudoku
+// Compile: g++ -std=c++11 sudoku_fixed.cpp -O2 -pthread -o sudoku
 
 #include <bits/stdc++.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define HAVE_HTTP_SERVER 1
+#endif
 using namespace std;
 
 using Board = array<array<int,9>,9>;
@@ -23,40 +35,516 @@ void printBoard(const Board &b) {
     cout << "+-------+-------+-------+\n";
 }
 
+// 81 characters, '.' for blanks (the format parseBoard and corpus files take)
+string boardToString(const Board &b) {
+    string s(81, '.');
+    for (int i=0;i<81;++i) if (b[i/9][i%9]) s[i] = (char)('0' + b[i/9][i%9]);
+    return s;
+}
+
+// Generic N x N grid (N = n*n) used by the engines that aren't limited to 9x9
+struct Grid {
+    int n = 3, N = 9;  // box side and grid side
+    vector<int> cells; // row-major, 0 = blank
+    int boxOf(int r, int c) const { return (r/n)*n + (c/n); }
+};
+
+// Parse an N x N grid. For N <= 9: N*N chars of digits or '.'/'0' (whitespace ignored);
+// for larger grids: N*N whitespace-separated numbers, with 0 or '.' for blanks.
+// Returns false if format wrong
+bool parseGrid(const string &s, int n, Grid &g) {
+    g.n = n; g.N = n*n;
+    g.cells.assign(g.N * g.N, 0);
+    vector<string> tokens;
+    if (g.N <= 9) {
+        for (char ch : s) if (!isspace((unsigned char)ch)) tokens.push_back(string(1, ch));
+    } else {
+        istringstream in(s);
+        string tok;
+        while (in >> tok) tokens.push_back(tok);
+    }
+    if ((int)tokens.size() != g.N * g.N) return false;
+    for (int i=0;i<(int)tokens.size();++i) {
+        const string &t = tokens[i];
+        if (t == "." || t == "0") continue;
+        int v = 0;
+        for (char ch : t) {
+            if (ch < '0' || ch > '9') return false;
+            v = v*10 + (ch - '0');
+            if (v > g.N) return false;
+        }
+        if (v == 0) return false;
+        g.cells[i] = v;
+    }
+    return true;
+}
+
+// Check that no digit repeats in a row, column or box
+bool gridConsistent(const Grid &g) {
+    vector<uint64_t> rowM(g.N), colM(g.N), boxM(g.N);
+    for (int r=0;r<g.N;++r) for (int c=0;c<g.N;++c) {
+        int v = g.cells[r*g.N + c];
+        if (v == 0) continue;
+        uint64_t bit = 1ULL << (v-1);
+        int bi = g.boxOf(r,c);
+        if ((rowM[r] | colM[c] | boxM[bi]) & bit) return false;
+        rowM[r] |= bit; colM[c] |= bit; boxM[bi] |= bit;
+    }
+    return true;
+}
+
+void printGrid(const Grid &g) {
+    int w = g.N > 9 ? 3 : 2;
+    for (int r=0;r<g.N;++r) {
+        if (r % g.n == 0 && r) cout << '\n';
+        for (int c=0;c<g.N;++c) {
+            if (c % g.n == 0 && c) cout << " |";
+            int v = g.cells[r*g.N + c];
+            cout << setw(w) << (v ? to_string(v) : string("."));
+        }
+        cout << '\n';
+    }
+}
+
 // Parse board from 81-char string of digits or '.'; returns false if format wrong
 bool parseBoard(const string &s, Board &b) {
-    string t;
-    for (char ch : s) if (!isspace((unsigned char)ch)) t.push_back(ch);
-    if (t.size() != 81) return false;
-    for (int i=0;i<81;++i) {
-        char ch = t[i];
-        int r = i/9, c = i%9;
-        if (ch == '.' || ch == '0') b[r][c] = 0;
-        else if (ch >= '1' && ch <= '9') b[r][c] = ch - '0';
-        else return false;
-    }
+    Grid g;
+    if (!parseGrid(s, 3, g)) return false;
+    for (int i=0;i<81;++i) b[i/9][i%9] = g.cells[i];
     return true;
 }
 
+// Learned digit-ordering model: a tiny 8-8-1 MLP scoring (cell, digit) features.
+// Weights are trained offline from solve traces (see trainValueModel) and stored as
+// plain whitespace-separated floats: W1 (8x8, row = input feature), b1 (8), w2 (8), b2.
+struct ValueModel {
+    static const int kFeatures = 8;
+    static const int kHidden = 8;
+    alignas(16) float w1[kFeatures][kHidden]; // w1[i][j]: weight of input i into hidden j
+    alignas(16) float b1[kHidden];
+    alignas(16) float w2[kHidden];
+    float b2;
+
+    ValueModel() { setDefaults(); }
+
+    // Hand-set weights approximating "least constraining value" until a trained file is loaded
+    void setDefaults() {
+        memset(w1, 0, sizeof(w1));
+        memset(b1, 0, sizeof(b1));
+        memset(w2, 0, sizeof(w2));
+        b2 = 0;
+        w1[0][0] = w1[1][0] = w1[2][0] = 1.0f; w2[0] = -1.0f; // peers that also want d
+        w1[4][1] = 1.0f; w2[1] = 4.0f;                        // hidden single for d
+    }
+
+    bool loadFromFile(const string &path) {
+        ifstream in(path);
+        if (!in) return false;
+        ValueModel m;
+        for (int i=0;i<kFeatures;++i) for (int j=0;j<kHidden;++j) if (!(in >> m.w1[i][j])) return false;
+        for (int j=0;j<kHidden;++j) if (!(in >> m.b1[j])) return false;
+        for (int j=0;j<kHidden;++j) if (!(in >> m.w2[j])) return false;
+        if (!(in >> m.b2)) return false;
+        *this = m;
+        return true;
+    }
+
+    bool saveToFile(const string &path) const {
+        ofstream out(path);
+        if (!out) return false;
+        out.precision(9);
+        for (int i=0;i<kFeatures;++i) { for (int j=0;j<kHidden;++j) out << w1[i][j] << ' '; out << '\n'; }
+        for (int j=0;j<kHidden;++j) out << b1[j] << ' ';
+        out << '\n';
+        for (int j=0;j<kHidden;++j) out << w2[j] << ' ';
+        out << '\n' << b2 << '\n';
+        return !out.fail();
+    }
+
+    // Forward pass; hidden activations are written to h when non-null (used by training)
+    inline float score(const float *f, float *h = nullptr) const {
+#if defined(__SSE2__)
+        __m128 lo = _mm_load_ps(b1), hi = _mm_load_ps(b1 + 4);
+        for (int i=0;i<kFeatures;++i) {
+            __m128 x = _mm_set1_ps(f[i]);
+            lo = _mm_add_ps(lo, _mm_mul_ps(x, _mm_load_ps(w1[i])));
+            hi = _mm_add_ps(hi, _mm_mul_ps(x, _mm_load_ps(w1[i] + 4)));
+        }
+        __m128 zero = _mm_setzero_ps();
+        lo = _mm_max_ps(lo, zero);
+        hi = _mm_max_ps(hi, zero);
+        if (h) { _mm_storeu_ps(h, lo); _mm_storeu_ps(h + 4, hi); }
+        __m128 acc = _mm_add_ps(_mm_mul_ps(lo, _mm_load_ps(w2)), _mm_mul_ps(hi, _mm_load_ps(w2 + 4)));
+        acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+        return _mm_cvtss_f32(acc) + b2;
+#else
+        float out = b2;
+        for (int j=0;j<kHidden;++j) {
+            float a = b1[j];
+            for (int i=0;i<kFeatures;++i) a += f[i] * w1[i][j];
+            if (a < 0) a = 0;
+            if (h) h[j] = a;
+            out += a * w2[j];
+        }
+        return out;
+#endif
+    }
+};
+
+// Zobrist keys: random 64-bit values per (cell, digit). A board hashes to the XOR of its placements;
+// a remaining-candidate state hashes to the XOR of candidate[cell][0] for each empty cell and
+// candidate[cell][d] for each digit d still possible there.
+struct ZobristKeys {
+    uint64_t key[81][10];
+    uint64_t candidate[81][10];
+    ZobristKeys() {
+        mt19937_64 gen(0x5d0c0ffeeULL);
+        for (auto &cell : key) for (auto &k : cell) k = gen();
+        for (auto &cell : candidate) for (auto &k : cell) k = gen();
+    }
+};
+static const ZobristKeys zobrist;
+
+uint64_t zobristHash(const Board &b) {
+    uint64_t h = 0;
+    for (int r=0;r<9;++r) for (int c=0;c<9;++c) if (b[r][c]) h ^= zobrist.key[r*9 + c][b[r][c]];
+    return h;
+}
+
+// Set of cells 0..80 as two 64-bit words
+struct Bits81 {
+    uint64_t lo = 0, hi = 0;
+    void set(int i) { if (i < 64) lo |= 1ULL << i; else hi |= 1ULL << (i - 64); }
+    void reset(int i) { if (i < 64) lo &= ~(1ULL << i); else hi &= ~(1ULL << (i - 64)); }
+    bool test(int i) const { return i < 64 ? (lo >> i) & 1 : (hi >> (i - 64)) & 1; }
+    bool any() const { return lo | hi; }
+    int count() const { return __builtin_popcountll(lo) + __builtin_popcountll(hi); }
+    int first() const { return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(hi); }
+    int popFirst() { int i = first(); if (lo) lo &= lo - 1; else hi &= hi - 1; return i; }
+    Bits81 operator&(const Bits81 &o) const { Bits81 r; r.lo = lo & o.lo; r.hi = hi & o.hi; return r; }
+    Bits81 operator|(const Bits81 &o) const { Bits81 r; r.lo = lo | o.lo; r.hi = hi | o.hi; return r; }
+    Bits81 operator~() const { Bits81 r; r.lo = ~lo; r.hi = ~hi & ((1ULL << 17) - 1); return r; }
+    bool operator==(const Bits81 &o) const { return lo == o.lo && hi == o.hi; }
+};
+
+// The cells sharing a row, column or box with each cell, as a list and as a set, and the
+// cells of the 27 units (rows 0-8, columns 9-17, boxes 18-26), likewise. Boxes come from a
+// region table (region[i] in 0..8, nine cells each), so jigsaw layouts get the same tables.
+// Classic boxes give every cell 20 peers; an irregular region that leaves the cell's row and
+// column bands adds more, up to 8 + 8 + 8.
+struct PeerTable {
+    uint8_t peers[81][24];
+    uint8_t peerCount[81];
+    Bits81 peerBits[81];
+    uint8_t units[27][9];
+    Bits81 unitBits[27];
+    explicit PeerTable(const uint8_t *region) {
+        int filled[9] = {};
+        for (int i=0;i<81;++i) {
+            units[i/9][i%9] = (uint8_t)i;
+            units[9 + i%9][i/9] = (uint8_t)i;
+            units[18 + region[i]][filled[region[i]]++] = (uint8_t)i;
+        }
+        for (int u=0;u<27;++u) for (int j=0;j<9;++j) unitBits[u].set(units[u][j]);
+        for (int i=0;i<81;++i) {
+            int n = 0;
+            for (int j=0;j<81;++j) {
+                if (j == i) continue;
+                if (j/9 == i/9 || j%9 == i%9 || region[j] == region[i]) {
+                    peers[i][n++] = (uint8_t)j;
+                    peerBits[i].set(j);
+                }
+            }
+            peerCount[i] = (uint8_t)n;
+        }
+    }
+};
+
+// Unit of each cell in 16-cell groups, as byte-shuffle indices for the vectorized MRV scan.
+// Lanes 81..95 point at slot 9 of the mask vectors, which always reads as "every digit used".
+// Built from a region table so any 9-region layout scans the same way.
+struct MrvLayout {
+    alignas(16) uint8_t row[96], col[96], box[96];
+    explicit MrvLayout(const uint8_t *regionOf) {
+        for (int i=0;i<96;++i) {
+            row[i] = (uint8_t)(i < 81 ? i/9 : 9);
+            col[i] = (uint8_t)(i < 81 ? i%9 : 9);
+            box[i] = (uint8_t)(i < 81 ? regionOf[i] : 9);
+        }
+    }
+};
+
+// Everything Solver derives from the region layout: region of each cell (indexes blockMask),
+// the peer/unit tables and the MRV shuffle indices. Compiled once per layout; classic boxes by
+// default. A region map that isn't nine regions of nine cells leaves valid false.
+struct RegionLayout {
+    uint8_t region[81];
+    bool valid;
+    uint64_t ttKey; // mixed into transposition-table keys so layouts don't share entries (0 = classic)
+    PeerTable peers;
+    MrvLayout mrv;
+    static const uint8_t *classicRegions() {
+        static const array<uint8_t,81> of = [] {
+            array<uint8_t,81> a;
+            for (int i=0;i<81;++i) a[i] = (uint8_t)blockIndex(i/9, i%9);
+            return a;
+        }();
+        return of.data();
+    }
+    RegionLayout() : RegionLayout(classicRegions()) {}
+    explicit RegionLayout(const uint8_t *regionOf) : valid(checkSizes(regionOf)), ttKey(valid ? keyOf(regionOf) : 0),
+        peers(valid ? regionOf : classicRegions()), mrv(valid ? regionOf : classicRegions()) {
+        memcpy(region, valid ? regionOf : classicRegions(), 81);
+    }
+    static uint64_t keyOf(const uint8_t *regionOf) {
+        if (!memcmp(regionOf, classicRegions(), 81)) return 0;
+        uint64_t h = 0xcbf29ce484222325ULL; // FNV-1a over the region map
+        for (int i=0;i<81;++i) h = (h ^ regionOf[i]) * 0x100000001b3ULL;
+        return h;
+    }
+    static bool checkSizes(const uint8_t *regionOf) {
+        int size[9] = {};
+        for (int i=0;i<81;++i) {
+            if (regionOf[i] > 8 || ++size[regionOf[i]] > 9) return false;
+        }
+        return true;
+    }
+};
+static const RegionLayout classicLayout;
+static const PeerTable &classicPeers = classicLayout.peers;
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define HAVE_SIMD_MRV 1
+// pshufb (SSSE3) isn't in the x86-64 baseline, so the kernel is compiled for it separately and
+// only called when the CPU reports it
+static bool detectSsse3() {
+    __builtin_cpu_init(); // may run before libgcc's own constructor
+    return __builtin_cpu_supports("ssse3");
+}
+static const bool kSimdMrv = detectSsse3();
+
+// MRV over the whole board in one pass: candidate masks of all 81 cells are rebuilt from the
+// unit masks with byte shuffles (low 8 digit bits and the digit-9 bit separately), counted with
+// a nibble-table popcount, filled cells forced to 0xFF, and the minimum found by a vector
+// reduction. Returns the first cell with the fewest candidates, -1 if the board is full, or -2 if
+// some empty cell has no candidates left.
+__attribute__((target("ssse3")))
+int simdMrvScan(const Board &board, const int *rowMask, const int *colMask, const int *blockMask, const MrvLayout &layout) {
+    alignas(16) uint8_t lo[3][16], hi[3][16];
+    const int *units[3] = {rowMask, colMask, blockMask};
+    for (int u=0;u<3;++u) {
+        for (int k=0;k<9;++k) { lo[u][k] = (uint8_t)units[u][k]; hi[u][k] = (uint8_t)(units[u][k] >> 8); }
+        for (int k=9;k<16;++k) { lo[u][k] = 0xFF; hi[u][k] = 1; }
+    }
+    const __m128i rowLo = _mm_load_si128((const __m128i *)lo[0]), rowHi = _mm_load_si128((const __m128i *)hi[0]);
+    const __m128i colLo = _mm_load_si128((const __m128i *)lo[1]), colHi = _mm_load_si128((const __m128i *)hi[1]);
+    const __m128i boxLo = _mm_load_si128((const __m128i *)lo[2]), boxHi = _mm_load_si128((const __m128i *)hi[2]);
+    const __m128i nibbleCount = _mm_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m128i low4 = _mm_set1_epi8(0x0F), one = _mm_set1_epi8(1), zero = _mm_setzero_si128();
+    const int *cells = board[0].data();
+    __m128i counts[6], best = _mm_set1_epi8((char)0xFF);
+    for (int g=0;g<6;++g) {
+        __m128i r = _mm_load_si128((const __m128i *)(layout.row + 16*g));
+        __m128i c = _mm_load_si128((const __m128i *)(layout.col + 16*g));
+        __m128i b = _mm_load_si128((const __m128i *)(layout.box + 16*g));
+        __m128i freeLo = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(rowLo, r), _mm_shuffle_epi8(colLo, c)),
+                                                       _mm_shuffle_epi8(boxLo, b)), _mm_set1_epi8((char)0xFF));
+        __m128i freeHi = _mm_andnot_si128(_mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(rowHi, r), _mm_shuffle_epi8(colHi, c)),
+                                                       _mm_shuffle_epi8(boxHi, b)), one);
+        __m128i cnt = _mm_add_epi8(_mm_add_epi8(_mm_shuffle_epi8(nibbleCount, _mm_and_si128(freeLo, low4)),
+                                                _mm_shuffle_epi8(nibbleCount, _mm_and_si128(_mm_srli_epi16(freeLo, 4), low4))), freeHi);
+        __m128i digits;
+        if (g < 5) {
+            const __m128i *p = (const __m128i *)(cells + 16*g);
+            digits = _mm_packs_epi16(_mm_packs_epi32(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+                                     _mm_packs_epi32(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+        } else {
+            digits = _mm_setr_epi8((char)cells[80], 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1); // padding lanes count as filled
+        }
+        cnt = _mm_or_si128(cnt, _mm_andnot_si128(_mm_cmpeq_epi8(digits, zero), _mm_set1_epi8((char)0xFF)));
+        counts[g] = cnt;
+        best = _mm_min_epu8(best, cnt);
+    }
+    best = _mm_min_epu8(best, _mm_srli_si128(best, 8));
+    best = _mm_min_epu8(best, _mm_srli_si128(best, 4));
+    best = _mm_min_epu8(best, _mm_srli_si128(best, 2));
+    best = _mm_min_epu8(best, _mm_srli_si128(best, 1));
+    int m = _mm_cvtsi128_si32(best) & 0xFF;
+    if (m == 0xFF) return -1;
+    if (m == 0) return -2;
+    __m128i target = _mm_set1_epi8((char)m);
+    for (int g=0;g<6;++g) {
+        int hit = _mm_movemask_epi8(_mm_cmpeq_epi8(counts[g], target));
+        if (hit) return 16*g + __builtin_ctz(hit);
+    }
+    return -1;
+}
+#else
+#define HAVE_SIMD_MRV 0
+static const bool kSimdMrv = false;
+#endif
+
+// Memo of exact subtree solution counts keyed by the remaining-candidate hash. The number of
+// completions depends only on which cells are empty and what each may still hold, so different
+// placements that leave the same candidates share an entry, and entries stay valid across solves.
+// Fixed memory: 2-way buckets; on collision the entry with the smaller subtree (work) is evicted.
+struct TranspositionTable {
+    struct Entry {
+        uint64_t key = 0;
+        long long count = 0;
+        long long work = -1; // nodes spent computing count; -1 = empty slot
+    };
+    vector<Entry> entries;
+    size_t mask = 0;
+    long long hits = 0, stores = 0;
+
+    explicit TranspositionTable(size_t megabytes = 16) {
+        size_t n = 2;
+        while (n * 2 * sizeof(Entry) <= megabytes * 1024 * 1024) n *= 2;
+        entries.resize(n);
+        mask = n - 1;
+    }
+
+    void clear() {
+        fill(entries.begin(), entries.end(), Entry());
+        hits = stores = 0;
+    }
+
+    bool probe(uint64_t key, long long &count) {
+        size_t i = key & mask & ~(size_t)1;
+        for (size_t j = i; j < i + 2; ++j) {
+            if (entries[j].work >= 0 && entries[j].key == key) { count = entries[j].count; ++hits; return true; }
+        }
+        return false;
+    }
+
+    void store(uint64_t key, long long count, long long work) {
+        size_t i = key & mask & ~(size_t)1;
+        Entry *victim = &entries[i];
+        for (size_t j = i; j < i + 2; ++j) {
+            if (entries[j].key == key || entries[j].work < 0) { victim = &entries[j]; break; }
+            if (entries[j].work < victim->work) victim = &entries[j];
+        }
+        if (victim->work >= 0 && victim->key != key && victim->work > work) return; // keep the costlier subtree
+        victim->key = key;
+        victim->count = count;
+        victim->work = work;
+        ++stores;
+    }
+};
+
+// Cheap per-puzzle features of a loaded board (used to pick an engine)
+struct PuzzleFeatures {
+    int clues = 0;             // given digits
+    int emptyAfterSingles = 0; // empty cells left once naked/hidden singles are exhausted
+    int minCandidates = 0;     // smallest candidate count among those cells (0 if none left)
+    double avgCandidates = 0;  // mean candidate count among those cells
+};
+
+// Search configurations the dispatcher can choose from
+enum class Engine { Mrv, Propagate, Learned };
+
+const char *engineName(Engine e) {
+    switch (e) {
+        case Engine::Mrv: return "mrv";
+        case Engine::Propagate: return "propagate";
+        case Engine::Learned: return "learned";
+    }
+    return "?";
+}
+
 // Solver class: supports solve and counting solutions up to a limit
 struct Solver {
     Board board;
     array<int,9> rowMask, colMask, blockMask; // bit masks: bit d-1 set if digit d is used
     vector<pair<int,int>> empties; // list of empty cells (r,c)
+    const ValueModel *model = nullptr; // optional learned digit ordering (nullptr = ascending digits)
+    long long nodes = 0; // search nodes visited by the last solve()
+    bool propagate = false; // apply naked/hidden singles at every node before branching
+    bool descendingDigits = false; // try digits 9..1 instead of 1..9 when no model is set
+    const atomic<bool> *cancel = nullptr; // optional external stop flag, polled once per node
+    bool cancelled = false; // last solve() was stopped through cancel
+    mt19937 *rng = nullptr; // randomized MRV tie-breaking and digit order when set
+    long long nodeLimit = 0; // stop solve() after this many nodes (0 = unlimited)
+    bool nodeLimitHit = false; // last solve() was stopped by nodeLimit
+    TranspositionTable *tt = nullptr; // optional memo of subtree solution counts
+    int ttMinOpen = 8; // only consult tt with at least this many empty cells (small subtrees are cheaper to search)
+    int open = 0; // empty cells on the board
+    bool maintainHash = true; // keep boardHash current on every place/undo
+    uint64_t boardHash = 0; // Zobrist hash of the placements (see hash())
+    uint64_t candHash = 0; // remaining-candidate hash, maintained only while trackCandHash is set
+    bool trackCandHash = false; // set by solve() while a transposition table is attached
+    bool verifyHash = false; // debug: recompute the hashes at every node and compare
+    long long hashMismatches = 0; // nodes where verifyHash found boardHash stale
+    PuzzleFeatures cachedFeatures; // valid while featuresValid; see features()
+    bool featuresValid = false; // cleared by loadBoard
+    bool copyOnBranch = false; // benchmark: snapshot the state per node instead of undoing via the trail
+    const RegionLayout *layout = &classicLayout; // box regions (and their peer tables) for blockMask
+    bool simdMrv = kSimdMrv; // pick the branching cell with the vectorized scan (needs SSSE3; ignored with rng)
+    function<void()> onFirstSolution; // called when solve() saves its first solution; may lower nodeLimit to stop there
+
+    // Undo log: every int overwritten through place() is pushed with its old value, and
+    // backtracking pops back to a saved mark. The XOR-maintained hashes are restored from the mark.
+    struct TrailEntry {
+        int *addr;
+        int old;
+    };
+    struct TrailMark {
+        size_t size;
+        uint64_t boardHash, candHash;
+    };
+    vector<TrailEntry> trail;
+    bool recordTrail = true; // off while copyOnBranch search restores snapshots instead
 
     Solver() { reset(); }
 
     void reset() {
         board = {};
+        clearDerived();
+    }
+
+    // Clear everything derived from the board (empties keeps its capacity)
+    void clearDerived() {
         rowMask.fill(0);
         colMask.fill(0);
         blockMask.fill(0);
         empties.clear();
+        trail.clear();
+        open = 0;
+        boardHash = 0;
+    }
+
+    // Restore search options to their defaults and clear the last caller's counters and flags
+    // (used when a pooled solver is handed back)
+    void resetOptions() {
+        model = nullptr;
+        propagate = false;
+        descendingDigits = false;
+        cancel = nullptr;
+        rng = nullptr;
+        nodeLimit = 0;
+        tt = nullptr;
+        ttMinOpen = 8;
+        maintainHash = true;
+        verifyHash = false;
+        hashMismatches = 0;
+        trackCandHash = false;
+        nodes = 0;
+        cancelled = false;
+        nodeLimitHit = false;
+        copyOnBranch = false;
+        simdMrv = kSimdMrv;
+        layout = &classicLayout;
+        onFirstSolution = nullptr;
     }
 
+    // 64-bit Zobrist hash of the current board, maintained incrementally (equals zobristHash(board))
+    uint64_t hash() const { return boardHash; }
+
     // Load board and init masks; returns false if invalid (conflict)
     bool loadBoard(const Board &b) {
-        reset();
+        clearDerived();
         board = b;
         for (int r=0;r<9;++r) for (int c=0;c<9;++c) {
             int v = board[r][c];
@@ -64,34 +552,270 @@ struct Solver {
             int bit = 1 << (v-1);
             if (rowMask[r] & bit) return false;
             if (colMask[c] & bit) return false;
-            int bi = blockIndex(r,c);
+            int bi = layout->region[r*9 + c];
             if (blockMask[bi] & bit) return false;
             rowMask[r] |= bit;
             colMask[c] |= bit;
             blockMask[bi] |= bit;
         }
         for (int r=0;r<9;++r) for (int c=0;c<9;++c) if (board[r][c]==0) empties.emplace_back(r,c);
+        open = (int)empties.size();
+        boardHash = zobristHash(board);
+        featuresValid = false;
         return true;
     }
 
     // returns bitmask of possible digits (bits 0..8)
     inline int candidatesMask(int r, int c) const {
-        int used = rowMask[r] | colMask[c] | blockMask[blockIndex(r,c)];
+        int used = rowMask[r] | colMask[c] | blockMask[layout->region[r*9 + c]];
         return (~used) & 0x1FF; // 9 bits
     }
 
+    // Zobrist hash of the remaining-candidate state (empty cells and their candidate masks)
+    uint64_t candidateStateHash() const {
+        uint64_t h = 0;
+        for (auto &e : empties) {
+            int r = e.first, c = e.second;
+            if (board[r][c] != 0) continue;
+            const uint64_t *k = zobrist.candidate[r*9 + c];
+            h ^= k[0];
+            for (int m = candidatesMask(r,c); m; m &= m - 1) h ^= k[__builtin_ctz(m) + 1];
+        }
+        return h;
+    }
+
+    // XOR (r,c)'s candidate keys and digit d's key on its empty peers into candHash.
+    // Called with the masks *without* the placement at (r,c).
+    void toggleCandHash(int r, int c, int d) {
+        int cell = r*9 + c;
+        const uint64_t *k = zobrist.candidate[cell];
+        candHash ^= k[0];
+        for (int m = candidatesMask(r,c); m; m &= m - 1) candHash ^= k[__builtin_ctz(m) + 1];
+        int bit = 1 << (d-1);
+        const PeerTable &pt = layout->peers;
+        for (int i=0;i<pt.peerCount[cell];++i) {
+            int p = pt.peers[cell][i], pr = p / 9, pc = p % 9;
+            if (board[pr][pc] == 0 && (candidatesMask(pr,pc) & bit)) candHash ^= zobrist.candidate[p][d];
+        }
+    }
+
+    TrailMark mark() const { return {trail.size(), boardHash, candHash}; }
+
+    // Whole search state, for the copy-on-branch comparison
+    struct Snapshot {
+        Board board;
+        array<int,9> rowMask, colMask, blockMask;
+        int open;
+        uint64_t boardHash, candHash;
+    };
+    Snapshot snapshot() const { return {board, rowMask, colMask, blockMask, open, boardHash, candHash}; }
+    void restore(const Snapshot &snap) {
+        board = snap.board;
+        rowMask = snap.rowMask;
+        colMask = snap.colMask;
+        blockMask = snap.blockMask;
+        open = snap.open;
+        boardHash = snap.boardHash;
+        candHash = snap.candHash;
+    }
+
+    void undoTo(const TrailMark &m) {
+        while (trail.size() > m.size) {
+            const TrailEntry &e = trail.back();
+            *e.addr = e.old;
+            trail.pop_back();
+        }
+        boardHash = m.boardHash;
+        candHash = m.candHash;
+    }
+
+    inline void assign(int &slot, int value) {
+        if (recordTrail) trail.push_back({&slot, slot});
+        slot = value;
+    }
+
+    // Place d at (r,c); undone by undoTo(a mark taken before)
+    inline void place(int r, int c, int d) {
+        int bit = 1 << (d-1);
+        if (trackCandHash) toggleCandHash(r, c, d);
+        if (maintainHash) boardHash ^= zobrist.key[r*9 + c][d];
+        int bi = layout->region[r*9 + c];
+        assign(board[r][c], d);
+        assign(open, open - 1);
+        assign(rowMask[r], rowMask[r] | bit);
+        assign(colMask[c], colMask[c] | bit);
+        assign(blockMask[bi], blockMask[bi] | bit);
+    }
+
+    // Place naked and hidden singles until none remain (on the trail); returns false on a contradiction
+    bool propagateSingles() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto &e : empties) {
+                int r = e.first, c = e.second;
+                if (board[r][c] != 0) continue;
+                int mask = candidatesMask(r,c);
+                if (mask == 0) return false;
+                if (mask & (mask - 1)) continue;
+                place(r, c, __builtin_ctz(mask) + 1);
+                changed = true;
+            }
+            if (changed) continue;
+            // hidden singles: a digit that fits only one cell of a row, column or box
+            for (int u = 0; u < 27; ++u) {
+                int cells[9], cand[9], once = 0, twice = 0, used;
+                for (int k=0;k<9;++k) {
+                    cells[k] = layout->peers.units[u][k];
+                    int r = cells[k] / 9, c = cells[k] % 9;
+                    cand[k] = board[r][c] ? 0 : candidatesMask(r,c);
+                    twice |= once & cand[k];
+                    once |= cand[k];
+                }
+                used = u < 9 ? rowMask[u] : (u < 18 ? colMask[u-9] : blockMask[u-18]);
+                if ((once | used) != 0x1FF) return false; // some digit has nowhere to go
+                int unique = once & ~twice;
+                for (int k=0;k<9 && unique;++k) if (int hit = cand[k] & unique) {
+                    if (hit & (hit - 1)) return false; // two digits forced into one cell
+                    place(cells[k]/9, cells[k]%9, __builtin_ctz(hit) + 1);
+                    unique &= ~hit;
+                    changed = true;
+                }
+                if (changed) break;
+            }
+        }
+        return true;
+    }
+
+    // Features of the loaded board, computed on first use after loadBoard (only the engine
+    // selector reads them, so plain loads don't pay for the singles pass). Call before solving.
+    const PuzzleFeatures &features() {
+        if (!featuresValid) computeFeatures();
+        return cachedFeatures;
+    }
+
+    void computeFeatures() {
+        PuzzleFeatures &features = cachedFeatures;
+        features = PuzzleFeatures();
+        features.clues = 81 - (int)empties.size();
+        TrailMark start = mark();
+        bool ok = propagateSingles();
+        int total = 0, minC = 10;
+        for (auto &e : empties) {
+            if (board[e.first][e.second] != 0) continue;
+            int cnt = __builtin_popcount(candidatesMask(e.first, e.second));
+            ++features.emptyAfterSingles;
+            total += cnt;
+            minC = min(minC, cnt);
+        }
+        if (!ok) minC = 0;
+        features.minCandidates = features.emptyAfterSingles ? minC : 0;
+        features.avgCandidates = features.emptyAfterSingles ? (double)total / features.emptyAfterSingles : 0;
+        undoTo(start);
+        featuresValid = true;
+    }
+
+    // Configure search for one of the dispatcher's engines
+    void useEngine(Engine e, const ValueModel *m) {
+        propagate = (e == Engine::Propagate);
+        model = (e == Engine::Learned) ? m : nullptr;
+    }
+
+    // Features of placing digit d (bit) at (r,c) for the value model; f must hold kFeatures floats
+    void digitFeatures(int r, int c, int bit, float *f) const {
+        int rowPeers = 0, colPeers = 0, boxPeers = 0, placed = 0;
+        int bi = layout->region[r*9 + c];
+        for (int k=0;k<9;++k) {
+            if (k != c && board[r][k] == 0 && (candidatesMask(r,k) & bit)) ++rowPeers;
+            if (k != r && board[k][c] == 0 && (candidatesMask(k,c) & bit)) ++colPeers;
+            int rr = layout->peers.units[18 + bi][k] / 9, cc = layout->peers.units[18 + bi][k] % 9;
+            if ((rr != r || cc != c) && board[rr][cc] == 0 && (candidatesMask(rr,cc) & bit)) ++boxPeers;
+        }
+        for (int i=0;i<9;++i) placed += __builtin_popcount(rowMask[i] & bit);
+        f[0] = rowPeers / 8.0f;
+        f[1] = colPeers / 8.0f;
+        f[2] = boxPeers / 8.0f;
+        f[3] = placed / 9.0f;
+        f[4] = (rowPeers == 0 || colPeers == 0 || boxPeers == 0) ? 1.0f : 0.0f;
+        f[5] = __builtin_popcount(candidatesMask(r,c)) / 9.0f;
+        f[6] = open / 81.0f;
+        f[7] = 1.0f;
+    }
+
+    // Fill out[] with the digits of mask in search order; returns how many
+    int orderDigits(int r, int c, int mask, int *out) const {
+        int n = 0;
+        while (mask) { int lb = mask & -mask; out[n++] = __builtin_ctz(lb) + 1; mask -= lb; }
+        if (n < 2) return n;
+        if (!model) {
+            if (rng) shuffle(out, out + n, *rng);
+            else if (descendingDigits) reverse(out, out + n);
+            return n;
+        }
+        float score[10];
+        alignas(16) float f[ValueModel::kFeatures];
+        for (int i=0;i<n;++i) {
+            digitFeatures(r, c, 1 << (out[i]-1), f);
+            score[out[i]] = model->score(f);
+        }
+        stable_sort(out, out + n, [&](int a, int b) { return score[a] > score[b]; });
+        return n;
+    }
+
     // Solve with backtracking; count solutions up to countLimit; outCount will contain number found (<= countLimit)
     // IMPORTANT: outCount must be provided by caller.
     bool solve(int countLimit, int &outCount) {
         outCount = 0;
+        nodes = 0;
+        cancelled = false;
+        nodeLimitHit = false;
         Board savedBoard;
         bool saved = false;
 
         // DFS returns true if search should stop (i.e., we've reached countLimit)
+        function<bool()> branch;
         function<bool()> dfs = [&]() -> bool {
             if (outCount >= countLimit) return true; // stop
+            if (cancel && cancel->load(memory_order_relaxed)) { cancelled = true; return true; }
+            if (nodeLimit && nodes >= nodeLimit) { nodeLimitHit = true; return true; }
+            ++nodes;
+            if (verifyHash && (zobristHash(board) != boardHash || (trackCandHash && candidateStateHash() != candHash))) ++hashMismatches;
+            uint64_t key = 0;
+            int before = outCount;
+            long long nodesBefore = nodes;
+            bool memo = tt && open >= ttMinOpen;
+            if (memo) {
+                key = candHash ^ layout->ttKey;
+                long long known;
+                // a memoized count can't supply the first solution itself, so only use hits once one is saved
+                if (tt->probe(key, known) && (known == 0 || saved)) {
+                    outCount += (int)min<long long>(known, countLimit - outCount);
+                    return outCount >= countLimit;
+                }
+            }
+            bool stop;
+            if (!propagate) {
+                stop = branch();
+            } else if (copyOnBranch) {
+                stop = propagateSingles() && branch(); // the parent's snapshot restore undoes this
+            } else {
+                TrailMark m = mark();
+                stop = propagateSingles() && branch();
+                undoTo(m);
+            }
+            if (memo && !stop) tt->store(key, outCount - before, nodes - nodesBefore + 1);
+            return stop;
+        };
+        branch = [&]() -> bool {
             // Find cell with minimum candidates (MRV)
-            int bestIdx = -1, bestCount = 10, bestMask = 0;
+            int bestCell = -1, bestCount = 10, bestMask = 0, ties = 0;
+#if HAVE_SIMD_MRV
+            if (simdMrv && !rng) {
+                int cell = simdMrvScan(board, rowMask.data(), colMask.data(), blockMask.data(), layout->mrv);
+                if (cell == -2) return false;
+                if (cell >= 0) { bestCell = cell; bestMask = candidatesMask(cell / 9, cell % 9); }
+            } else
+#endif
             for (int i = 0; i < (int)empties.size(); ++i) {
                 int r = empties[i].first;
                 int c = empties[i].second;
@@ -99,39 +823,49 @@ struct Solver {
                 int mask = candidatesMask(r,c);
                 if (mask == 0) return false; // dead end on this path
                 int cnt = __builtin_popcount(mask);
-                if (cnt < bestCount) { bestCount = cnt; bestIdx = i; bestMask = mask; if (cnt==1) break; }
+                if (cnt < bestCount) { bestCount = cnt; bestCell = r*9 + c; bestMask = mask; ties = 1; if (cnt==1) break; }
+                else if (rng && cnt == bestCount && (*rng)() % ++ties == 0) { bestCell = r*9 + c; bestMask = mask; } // reservoir pick among ties
             }
-            if (bestIdx == -1) {
+            if (bestCell == -1) {
                 // Found a full solution
                 ++outCount;
-                if (!saved) { saved = true; savedBoard = board; } // save first found solution
+                if (!saved) { // save first found solution
+                    saved = true;
+                    savedBoard = board;
+                    if (onFirstSolution) onFirstSolution();
+                }
                 return outCount >= countLimit; // if we've reached limit -> tell callers to stop
             }
-            int r = empties[bestIdx].first, c = empties[bestIdx].second;
-            int m = bestMask;
-            while (m && outCount < countLimit) {
-                int lowbit = m & -m;
-                int d = __builtin_ctz(lowbit) + 1; // digit to try
-                m -= lowbit;
-                int bit = 1 << (d-1);
-                // place d
-                board[r][c] = d;
-                rowMask[r] |= bit;
-                colMask[c] |= bit;
-                blockMask[blockIndex(r,c)] |= bit;
+            int r = bestCell / 9, c = bestCell % 9;
+            int digits[9];
+            int nd = orderDigits(r, c, bestMask, digits);
+            Snapshot snap;
+            if (copyOnBranch) snap = snapshot();
+            for (int k = 0; k < nd && outCount < countLimit; ++k) {
+                int d = digits[k]; // digit to try
+                TrailMark m = mark();
+                place(r, c, d);
                 bool stop = dfs();
-                // undo
-                board[r][c] = 0;
-                rowMask[r] &= ~bit;
-                colMask[c] &= ~bit;
-                blockMask[blockIndex(r,c)] &= ~bit;
+                if (copyOnBranch) restore(snap); // also wipes whatever the child propagated
+                else undoTo(m);
                 if (stop) return true;
             }
             return false;
         };
 
+        trackCandHash = (tt != nullptr);
+        if (trackCandHash) candHash = candidateStateHash();
+        recordTrail = !copyOnBranch;
+        Snapshot root = snapshot();
         dfs();
-        if (saved) board = savedBoard; // restore the first solution into board so caller can print it
+        if (copyOnBranch) restore(root);
+        recordTrail = true;
+        trackCandHash = false;
+        if (saved) { // restore the first solution into board so caller can print it
+            board = savedBoard;
+            open = 0;
+            if (maintainHash) boardHash = zobristHash(board);
+        }
         return outCount >= 1;
     }
 
@@ -142,14 +876,402 @@ struct Solver {
         return ok;
     }
 
+    // Find one solution with randomized search restarted on a Luby schedule (base, base, 2*base,
+    // base, base, 2*base, 4*base, ... nodes). Cuts the heavy tail of unlucky early decisions.
+    // Returns false only once a run completes without a solution; restarts/totalNodes report the effort.
+    bool solveOneWithRestarts(mt19937 &r, long long baseNodes, int *restarts = nullptr, long long *totalNodes = nullptr) {
+        mt19937 *savedRng = rng;
+        long long savedLimit = nodeLimit;
+        rng = &r;
+        long long total = 0;
+        int run = 1;
+        int cnt = 0;
+        while (true) {
+            nodeLimit = luby(run) * baseNodes;
+            solve(1, cnt);
+            total += nodes;
+            if (cnt > 0 || !nodeLimitHit || cancelled) break;
+            ++run;
+        }
+        rng = savedRng;
+        nodeLimit = savedLimit;
+        if (restarts) *restarts = run - 1;
+        if (totalNodes) *totalNodes = total;
+        return cnt > 0;
+    }
+
+    // i-th term (1-based) of the Luby sequence 1,1,2,1,1,2,4,1,1,2,...
+    static long long luby(long long i) {
+        while (true) {
+            int k = 1;
+            while ((1LL << k) - 1 < i) ++k;
+            if (i == (1LL << k) - 1) return 1LL << (k-1);
+            i -= (1LL << (k-1)) - 1;
+        }
+    }
+
     // Count solutions up to limit (returns number found, at most limit)
     int countSolutions(int limit=2) {
         int cnt = 0;
         solve(limit, cnt);
         return cnt;
     }
+
+    // Count solutions up to limit, splitting the empty cells into independent components whenever
+    // possible and multiplying their counts. Two empty cells interact only if they share a unit and
+    // a candidate; candidates only shrink, so once a group has no such link to the rest it never will.
+    // Uses tt (keyed by the component's candidate hash) when attached. Leaves the board unchanged.
+    long long countSolutionsDecomposed(long long limit) {
+        nodes = 0;
+        Bits81 cells;
+        for (auto &e : empties) if (board[e.first][e.second] == 0) cells.set(e.first*9 + e.second);
+        return countCells(cells, limit);
+    }
+
+    long long countCells(Bits81 cells, long long limit) {
+        ++nodes;
+        // place forced cells first: component analysis only pays off at real branch points
+        TrailMark m = mark();
+        long long result = countAfterSingles(cells, limit);
+        undoTo(m);
+        return result;
+    }
+
+    long long countAfterSingles(Bits81 cells, long long limit) {
+        Bits81 live, with[9]; // empty cells, and those among them that can still hold each digit
+        int cand[81], best = -1, bestCount = 10;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            live = Bits81();
+            for (auto &w : with) w = Bits81();
+            best = -1; bestCount = 10;
+            for (Bits81 it = cells; it.any(); ) {
+                int i = it.popFirst();
+                if (board[i/9][i%9] != 0) continue;
+                cand[i] = candidatesMask(i/9, i%9);
+                if (cand[i] == 0) return 0;
+                if (!(cand[i] & (cand[i] - 1)) && (changed || it.any() || live.any())) { // naked single (unless it's the last cell)
+                    place(i/9, i%9, __builtin_ctz(cand[i]) + 1);
+                    changed = true;
+                    continue;
+                }
+                live.set(i);
+                for (int m = cand[i]; m; m &= m - 1) with[__builtin_ctz(m)].set(i);
+                int cnt = __builtin_popcount(cand[i]);
+                if (cnt < bestCount) { bestCount = cnt; best = i; }
+            }
+            cells = live;
+        }
+        int n = live.count();
+        if (n == 0) return 1;
+        if (n == 1) return min<long long>(__builtin_popcount(cand[best]), limit); // lone cell: any candidate works
+
+        // grow the component of the first cell over "shares a unit and a candidate"
+        Bits81 comp, frontier;
+        comp.set(live.first());
+        frontier = comp;
+        while (frontier.any()) {
+            int a = frontier.popFirst();
+            Bits81 reach;
+            for (int m = cand[a]; m; m &= m - 1) reach = reach | (layout->peers.peerBits[a] & with[__builtin_ctz(m)]);
+            reach = reach & ~comp;
+            comp = comp | reach;
+            frontier = frontier | reach;
+        }
+        if (!(comp == live)) {
+            long long k = countCells(comp, limit);
+            if (k == 0) return 0;
+            long long rest = countCells(live & ~comp, limit); // splits further if it isn't connected either
+            if (rest == 0) return 0;
+            return (k > limit / rest) ? limit : min(limit, k * rest);
+        }
+
+        uint64_t key = layout->ttKey;
+        bool memo = tt && n >= ttMinOpen;
+        if (memo) {
+            for (Bits81 it = live; it.any(); ) {
+                int i = it.popFirst();
+                const uint64_t *k = zobrist.candidate[i];
+                key ^= k[0];
+                for (int m = cand[i]; m; m &= m - 1) key ^= k[__builtin_ctz(m) + 1];
+            }
+            long long known;
+            if (tt->probe(key, known)) return min(known, limit);
+        }
+        long long total = 0, nodesBefore = nodes;
+        int r = best / 9, c = best % 9;
+        for (int m = cand[best]; m && total < limit; m &= m - 1) {
+            TrailMark before = mark();
+            place(r, c, __builtin_ctz(m) + 1);
+            total += countCells(live, limit - total);
+            undoTo(before);
+        }
+        if (memo && total < limit) tt->store(key, total, nodes - nodesBefore + 1);
+        return min(total, limit);
+    }
+};
+
+// Pool of warm Solver instances. Acquiring one reuses an instance (and its heap buffers) released
+// earlier; loadBoard overwrites all board-derived state, so the only reset needed on release is
+// putting the search options back to their defaults and clearing the per-use counters. Each
+// thread keeps a small lock-free cache and hands it to a shared, mutex-protected list when it
+// exits, so short-lived threads (portfolio racers, parallel checks) pick up solvers warmed by
+// earlier ones instead of allocating afresh.
+class PooledSolver {
+public:
+    PooledSolver() {
+        vector<unique_ptr<Solver>> &local = localCache().solvers;
+        if (!local.empty()) {
+            solver = move(local.back());
+            local.pop_back();
+            return;
+        }
+        Shared &shared = sharedPool();
+        {
+            lock_guard<mutex> lk(shared.m);
+            if (!shared.solvers.empty()) {
+                solver = move(shared.solvers.back());
+                shared.solvers.pop_back();
+            }
+        }
+        if (!solver) solver.reset(new Solver());
+    }
+    ~PooledSolver() {
+        vector<unique_ptr<Solver>> &local = localCache().solvers;
+        solver->resetOptions();
+        if (local.size() < kMaxPerThread) local.push_back(move(solver));
+        else giveBack(solver);
+    }
+    PooledSolver(const PooledSolver &) = delete;
+    PooledSolver &operator=(const PooledSolver &) = delete;
+
+    Solver &operator*() { return *solver; }
+    Solver *operator->() { return solver.get(); }
+
+private:
+    static const size_t kMaxPerThread = 8, kMaxShared = 64;
+    unique_ptr<Solver> solver;
+
+    struct Shared {
+        mutex m;
+        vector<unique_ptr<Solver>> solvers;
+    };
+    static Shared &sharedPool() {
+        static Shared shared;
+        return shared;
+    }
+    static void giveBack(unique_ptr<Solver> &s) {
+        Shared &shared = sharedPool();
+        lock_guard<mutex> lk(shared.m);
+        if (shared.solvers.size() < kMaxShared) shared.solvers.push_back(move(s));
+    }
+
+    struct LocalCache {
+        vector<unique_ptr<Solver>> solvers;
+        LocalCache() { sharedPool(); } // constructed first, so it is destroyed after every cache
+        ~LocalCache() { for (auto &s : solvers) giveBack(s); }
+    };
+    static LocalCache &localCache() {
+        static thread_local LocalCache cache;
+        return cache;
+    }
+};
+
+// ---- Copy-on-branch search ----
+
+// The whole search state in 176 bytes: one 16-bit word per cell holding its remaining candidates
+// (eliminated eagerly from peers on every placement), or kFilled plus the digit bit once placed.
+// Small enough that copying it per branch beats keeping an undo trail; the copy is eleven
+// aligned 16-byte moves.
+struct alignas(16) CompactState {
+    static const uint16_t kFilled = 0x8000;
+    uint16_t cell[81];
+    uint8_t open;
+    uint8_t pad[13];
+
+    void copyFrom(const CompactState &o) {
+#if defined(__SSE2__)
+        const __m128i *src = reinterpret_cast<const __m128i *>(&o);
+        __m128i *dst = reinterpret_cast<__m128i *>(this);
+        for (int k = 0; k < (int)(sizeof(CompactState) / 16); ++k) _mm_store_si128(dst + k, _mm_load_si128(src + k));
+#else
+        memcpy(this, &o, sizeof(CompactState));
+#endif
+    }
+
+    // Place d (1..9) at cell i and strike it from the peers; false if a peer runs out of candidates
+    bool place(int i, int d) {
+        uint16_t bit = (uint16_t)(1 << (d-1));
+        cell[i] = kFilled | bit;
+        --open;
+        for (int k=0;k<20;++k) {
+            uint16_t &p = cell[classicPeers.peers[i][k]];
+            if (p & kFilled) continue;
+            if ((p &= (uint16_t)~bit) == 0) return false;
+        }
+        return true;
+    }
+
+    // Naked and hidden singles to a fixpoint, as Solver::propagateSingles; false on a contradiction
+    bool propagateSingles() {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i=0;i<81;++i) {
+                int m = cell[i];
+                if ((m & kFilled) || (m & (m - 1))) continue;
+                if (!place(i, __builtin_ctz(m) + 1)) return false;
+                changed = true;
+            }
+            if (changed) continue;
+            for (int u = 0; u < 27; ++u) {
+                int cells[9], cand[9], once = 0, twice = 0, used = 0;
+                for (int k=0;k<9;++k) {
+                    int r = u < 9 ? u : (u < 18 ? k : (u-18)/3*3 + k/3);
+                    int c = u < 9 ? k : (u < 18 ? u-9 : (u-18)%3*3 + k%3);
+                    cells[k] = r*9 + c;
+                    int m = cell[cells[k]];
+                    if (m & kFilled) { used |= m & 0x1FF; cand[k] = 0; continue; }
+                    cand[k] = m;
+                    twice |= once & m;
+                    once |= m;
+                }
+                if ((once | used) != 0x1FF) return false;
+                int unique = once & ~twice;
+                for (int k=0;k<9 && unique;++k) if (int hit = cand[k] & unique) {
+                    if (hit & (hit - 1)) return false;
+                    if (!place(cells[k], __builtin_ctz(hit) + 1)) return false;
+                    unique &= ~hit;
+                    changed = true;
+                }
+                if (changed) break;
+            }
+        }
+        return true;
+    }
+};
+
+// Counting search over CompactState: each child is a fresh copy of its parent, nothing is undone.
+// Same MRV cell choice and ascending digit order as Solver, so it visits the same tree minus the
+// children that eager elimination already rules out.
+struct CopySolver {
+    CompactState root;
+    Board board; // first solution after a successful solve
+    long long nodes = 0;
+    bool propagate = false;
+
+    bool loadBoard(const Board &b) {
+        root.copyFrom(CompactState());
+        root.open = 81;
+        for (int i=0;i<81;++i) root.cell[i] = 0x1FF;
+        board = b;
+        for (int i=0;i<81;++i) {
+            int d = b[i/9][i%9];
+            if (d == 0) continue;
+            if (!(root.cell[i] & (1 << (d-1)))) return false;
+            if (!root.place(i, d)) return false;
+        }
+        return true;
+    }
+
+    int countSolutions(int limit = 2) {
+        nodes = 0;
+        int found = 0;
+        CompactState s;
+        s.copyFrom(root);
+        if (!propagate || s.propagateSingles()) dfs(s, limit, found);
+        return found;
+    }
+
+private:
+    bool dfs(const CompactState &s, int limit, int &found) {
+        ++nodes;
+        int best = -1, bestCount = 10;
+        for (int i=0;i<81;++i) {
+            if (s.cell[i] & CompactState::kFilled) continue;
+            int cnt = __builtin_popcount(s.cell[i]);
+            if (cnt < bestCount) { bestCount = cnt; best = i; if (cnt == 1) break; }
+        }
+        if (best == -1) {
+            if (found++ == 0) for (int i=0;i<81;++i) board[i/9][i%9] = __builtin_ctz(s.cell[i] & 0x1FF) + 1;
+            return found >= limit;
+        }
+        CompactState child;
+        for (int m = s.cell[best]; m; m &= m - 1) {
+            child.copyFrom(s);
+            if (!child.place(best, __builtin_ctz(m) + 1)) continue;
+            if (propagate && !child.propagateSingles()) continue;
+            if (dfs(child, limit, found)) return true;
+        }
+        return false;
+    }
+};
+
+// ---- Singles-only solving ----
+
+// Propagation-only solver for the easy tier. possible[d] holds the empty cells that can still take
+// digit d+1: naked singles fall out of bit-sliced counting across the nine planes and hidden
+// singles out of a popcount per unit, and every single found in a sweep is placed at once. No
+// branching, so a puzzle it fills has exactly one solution.
+struct SinglesSolver {
+    Bits81 possible[9];
+    Bits81 empty;
+    Board board;
+
+    bool load(const Board &b) {
+        board = b;
+        empty = Bits81();
+        for (int i=0;i<81;++i) if (!b[i/9][i%9]) empty.set(i);
+        for (auto &p : possible) p = empty;
+        Bits81 given[9];
+        for (int i=0;i<81;++i) {
+            int d = b[i/9][i%9] - 1;
+            if (d < 0) continue;
+            if ((given[d] & classicPeers.peerBits[i]).any()) return false;
+            given[d].set(i);
+            possible[d] = possible[d] & ~classicPeers.peerBits[i];
+        }
+        return true;
+    }
+
+    void place(int i, int d) {
+        board[i/9][i%9] = d + 1;
+        empty.reset(i);
+        for (auto &p : possible) p.reset(i);
+        possible[d] = possible[d] & ~classicPeers.peerBits[i];
+    }
+
+    // True iff naked and hidden singles alone fill the grid (board then holds the solution)
+    bool solve() {
+        while (empty.any()) {
+            Bits81 once, twice;
+            for (auto &p : possible) { twice = twice | (once & p); once = once | p; }
+            if (!((empty & ~once) == Bits81())) return false; // a cell with no candidates
+            Bits81 naked = once & ~twice;
+            bool progress = naked.any();
+            while (naked.any()) {
+                int i = naked.popFirst(), d = 0;
+                while (d < 9 && !possible[d].test(i)) ++d;
+                if (d == 9) return false; // an earlier single in this sweep took its last digit
+                place(i, d);
+            }
+            if (progress) continue;
+            for (int d=0;d<9;++d) for (int u=0;u<27;++u) {
+                Bits81 where = possible[d] & classicPeers.unitBits[u];
+                if (where.any() && where.count() == 1) { place(where.first(), d); progress = true; }
+            }
+            if (!progress) return false;
+        }
+        return true;
+    }
 };
 
+bool singlesSolvable(const Board &b) {
+    SinglesSolver s;
+    return s.load(b) && s.solve();
+}
+
 // (The rest of your generator code left mostly unchanged)
 
 // Generate a full solved board via randomized backtracking
@@ -231,14 +1353,17 @@ Board generateFullSolution(mt19937 &rng) {
     return b;
 }
 
-Board generatePuzzle(mt19937 &rng, int targetClues = 30) {
+// singlesOnly: only remove a clue if singles alone still solve the puzzle (easy tier); that test
+// implies uniqueness and is far cheaper than countSolutions(2)
+Board generatePuzzle(mt19937 &rng, int targetClues = 30, bool singlesOnly = false) {
     Board solution = generateFullSolution(rng);
     Board puzzle = solution;
     vector<pair<int,int>> positions;
     for (int r=0;r<9;++r) for (int c=0;c<9;++c) positions.emplace_back(r,c);
     shuffle(positions.begin(), positions.end(), rng);
 
-    Solver solver;
+    PooledSolver pooled;
+    Solver &solver = *pooled;
     for (auto pos : positions) {
         int filled = 0;
         for (int r=0;r<9;++r) for (int c=0;c<9;++c) if (puzzle[r][c] != 0) ++filled;
@@ -249,6 +1374,10 @@ Board generatePuzzle(mt19937 &rng, int targetClues = 30) {
         int old = puzzle[r][c];
         puzzle[r][c] = 0;
 
+        if (singlesOnly) {
+            if (!singlesSolvable(puzzle)) puzzle[r][c] = old;
+            continue;
+        }
         if (!solver.loadBoard(puzzle)) { puzzle[r][c] = old; continue; }
         int cnt = solver.countSolutions(2);
         if (cnt != 1) {
@@ -274,41 +1403,4370 @@ int difficultyToClues(const string &diff) {
     }
 }
 
-void menu() {
-    cout << "AI-Powered Sudoku - Solver & Generator\n";
-    cout << "Options:\n";
-    cout << "  1 - Generate puzzle (easy/medium/hard or specify number of clues e.g. 30)\n";
-    cout << "  2 - Solve puzzle (enter 81 characters: digits or . for blanks)\n";
-    cout << "  0 - Exit\n";
+// ---- Technique rating ----
+
+// Human solving techniques, easiest first; Search means logic alone stalls
+enum class Technique { NakedSingle, HiddenSingle, LockedCandidates, NakedPair, HiddenPair, NakedTriple, XWing, Search };
+const int kTechniques = 8;
+
+const char *techniqueName(Technique t) {
+    static const char *names[kTechniques] = {"naked single", "hidden single", "locked candidates", "naked pair",
+                                             "hidden pair", "naked triple", "x-wing", "search"};
+    return names[(int)t];
 }
 
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
-    mt19937 rng((unsigned)chrono::high_resolution_clock::now().time_since_epoch().count());
+// Difficulty tiers by the hardest technique needed: singles; locked candidates and pairs;
+// triples and X-wing; anything beyond (search)
+const char *kTierNames[4] = {"easy", "medium", "hard", "expert"};
 
-    while (true) {
-        menu();
-        cout << "Choose option: ";
-        int opt;
-        if (!(cin >> opt)) return 0;
-        if (opt == 0) return 0;
-        if (opt == 1) {
+int techniqueTier(Technique t) {
+    if (t <= Technique::HiddenSingle) return 0;
+    if (t <= Technique::HiddenPair) return 1;
+    if (t <= Technique::XWing) return 2;
+    return 3;
+}
+
+// -1 if s names no tier
+int parseTier(const string &s) {
+    for (int t=0;t<4;++t) if (s == kTierNames[t]) return t;
+    return -1;
+}
+
+struct TechniqueRating {
+    Technique hardest = Technique::NakedSingle;
+    bool solved = false;         // logic finished the grid (hardest is Search otherwise)
+    int steps[kTechniques] = {}; // times each technique made progress
+    int tier() const { return techniqueTier(hardest); }
+};
+
+// Candidate grid for the rater. Each technique method makes at most one deduction and reports
+// whether it made progress; broken is set once a cell or unit runs out of options.
+struct LogicGrid {
+    int cell[81]; // placed digit or 0
+    int cand[81]; // candidates of empty cells (0 once placed)
+    int open = 0;
+    bool broken = false;
+
+    bool load(const Board &b) {
+        int used[27] = {};
+        open = 0;
+        broken = false;
+        for (int i=0;i<81;++i) {
+            int r = i/9, c = i%9, d = b[r][c];
+            cell[i] = d;
+            if (!d) { ++open; continue; }
+            int bit = 1 << (d-1);
+            if ((used[r] | used[9+c] | used[18+blockIndex(r,c)]) & bit) return false;
+            used[r] |= bit; used[9+c] |= bit; used[18+blockIndex(r,c)] |= bit;
+        }
+        for (int i=0;i<81;++i) {
+            int r = i/9, c = i%9;
+            cand[i] = cell[i] ? 0 : ~(used[r] | used[9+c] | used[18+blockIndex(r,c)]) & 0x1FF;
+            if (!cell[i] && !cand[i]) return false;
+        }
+        return true;
+    }
+
+    void place(int i, int d) {
+        int bit = 1 << (d-1);
+        cell[i] = d;
+        cand[i] = 0;
+        --open;
+        for (int k=0;k<20;++k) {
+            int p = classicPeers.peers[i][k];
+            if (cell[p] || !(cand[p] & bit)) continue;
+            if (!(cand[p] &= ~bit)) broken = true;
+        }
+    }
+
+    // Remove mask from the candidates of empty cell i; true if that changed anything
+    bool strike(int i, int mask) {
+        if (cell[i] || !(cand[i] & mask)) return false;
+        if (!(cand[i] &= ~mask)) broken = true;
+        return true;
+    }
+
+    bool nakedSingle() {
+        for (int i=0;i<81;++i) if (!cell[i] && !(cand[i] & (cand[i] - 1))) { place(i, __builtin_ctz(cand[i]) + 1); return true; }
+        return false;
+    }
+
+    bool hiddenSingle() {
+        for (int u=0;u<27;++u) {
+            int once = 0, twice = 0, placed = 0;
+            for (int k=0;k<9;++k) {
+                int i = classicPeers.units[u][k];
+                if (cell[i]) { placed |= 1 << (cell[i]-1); continue; }
+                twice |= once & cand[i];
+                once |= cand[i];
+            }
+            if ((once | placed) != 0x1FF) { broken = true; return false; }
+            int unique = once & ~twice;
+            if (!unique) continue;
+            int bit = unique & -unique;
+            for (int k=0;k<9;++k) {
+                int i = classicPeers.units[u][k];
+                if (cand[i] & bit) { place(i, __builtin_ctz(bit) + 1); return true; }
+            }
+        }
+        return false;
+    }
+
+    // Pointing (a box's candidates for d lie on one line) and claiming (a line's lie in one box)
+    bool lockedCandidates() {
+        for (int u=0;u<27;++u) for (int d=0;d<9;++d) {
+            int bit = 1 << d, rows = 0, cols = 0, boxes = 0;
+            for (int k=0;k<9;++k) {
+                int i = classicPeers.units[u][k];
+                if (!(cand[i] & bit)) continue;
+                rows |= 1 << (i/9); cols |= 1 << (i%9); boxes |= 1 << blockIndex(i/9, i%9);
+            }
+            if (!rows) continue;
+            int target = -1;
+            if (u >= 18 && !(rows & (rows - 1))) target = __builtin_ctz(rows);
+            else if (u >= 18 && !(cols & (cols - 1))) target = 9 + __builtin_ctz(cols);
+            else if (u < 18 && !(boxes & (boxes - 1))) target = 18 + __builtin_ctz(boxes);
+            if (target < 0) continue;
+            bool progress = false;
+            for (int k=0;k<9;++k) {
+                int i = classicPeers.units[target][k];
+                bool inSource = u < 9 ? i/9 == u : (u < 18 ? i%9 == u-9 : blockIndex(i/9, i%9) == u-18);
+                if (!inSource) progress |= strike(i, bit);
+            }
+            if (progress) return true;
+        }
+        return false;
+    }
+
+    // n empty cells of a unit whose candidates together hold exactly n digits (n = 2 or 3)
+    bool nakedSubset(int n) {
+        for (int u=0;u<27;++u) {
+            int small = 0; // unit positions of empty cells with 2..n candidates
+            for (int k=0;k<9;++k) {
+                int cnt = __builtin_popcount(cand[classicPeers.units[u][k]]);
+                if (cnt >= 2 && cnt <= n) small |= 1 << k;
+            }
+            for (int sel = small; sel; sel = (sel - 1) & small) { // every subset of small
+                if (__builtin_popcount(sel) != n) continue;
+                int uni = 0;
+                for (int w = sel; w; w &= w - 1) uni |= cand[classicPeers.units[u][__builtin_ctz(w)]];
+                if (__builtin_popcount(uni) != n) continue;
+                bool progress = false;
+                for (int k=0;k<9;++k) if (!(sel & (1 << k))) progress |= strike(classicPeers.units[u][k], uni);
+                if (progress) return true;
+            }
+        }
+        return false;
+    }
+
+    // Two digits confined to the same two cells of a unit: those cells hold nothing else
+    bool hiddenPair() {
+        for (int u=0;u<27;++u) {
+            int where[9] = {};
+            for (int k=0;k<9;++k) for (int d=0;d<9;++d) if (cand[classicPeers.units[u][k]] & (1 << d)) where[d] |= 1 << k;
+            for (int d1=0;d1<9;++d1) {
+                if (__builtin_popcount(where[d1]) != 2) continue;
+                for (int d2=d1+1;d2<9;++d2) {
+                    if (where[d2] != where[d1]) continue;
+                    int keep = (1 << d1) | (1 << d2);
+                    bool progress = false;
+                    for (int w = where[d1]; w; w &= w - 1) progress |= strike(classicPeers.units[u][__builtin_ctz(w)], 0x1FF & ~keep);
+                    if (progress) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // A digit confined to the same two columns in two rows leaves the rest of those columns (and transposed)
+    bool xWing() {
+        for (int d=0;d<9;++d) for (int t=0;t<2;++t) {
+            int bit = 1 << d, lines[9];
+            for (int a=0;a<9;++a) {
+                lines[a] = 0;
+                for (int b=0;b<9;++b) if (cand[t ? b*9 + a : a*9 + b] & bit) lines[a] |= 1 << b;
+            }
+            for (int a1=0;a1<9;++a1) {
+                if (__builtin_popcount(lines[a1]) != 2) continue;
+                for (int a2=a1+1;a2<9;++a2) {
+                    if (lines[a2] != lines[a1]) continue;
+                    bool progress = false;
+                    for (int a=0;a<9;++a) {
+                        if (a == a1 || a == a2) continue;
+                        for (int w = lines[a1]; w; w &= w - 1) {
+                            int b = __builtin_ctz(w);
+                            progress |= strike(t ? b*9 + a : a*9 + b, bit);
+                        }
+                    }
+                    if (progress) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool apply(Technique t) {
+        switch (t) {
+            case Technique::NakedSingle: return nakedSingle();
+            case Technique::HiddenSingle: return hiddenSingle();
+            case Technique::LockedCandidates: return lockedCandidates();
+            case Technique::NakedPair: return nakedSubset(2);
+            case Technique::HiddenPair: return hiddenPair();
+            case Technique::NakedTriple: return nakedSubset(3);
+            case Technique::XWing: return xWing();
+            case Technique::Search: return false;
+        }
+        return false;
+    }
+};
+
+// Rate a puzzle by repeatedly applying the easiest technique that makes progress. Techniques
+// beyond maxTechnique are not tried, so maxTechnique = HiddenSingle is a singles-only test.
+TechniqueRating rateTechniques(const Board &p, Technique maxTechnique = Technique::XWing) {
+    TechniqueRating out;
+    LogicGrid g;
+    if (!g.load(p)) { out.hardest = Technique::Search; return out; }
+    while (g.open > 0 && !g.broken) {
+        int t = 0;
+        while (t <= (int)maxTechnique && !g.apply((Technique)t)) ++t;
+        if (t > (int)maxTechnique) break;
+        ++out.steps[t];
+        out.hardest = max(out.hardest, (Technique)t);
+    }
+    out.solved = (g.open == 0 && !g.broken);
+    if (!out.solved) out.hardest = Technique::Search;
+    return out;
+}
+
+// ---- Stochastic local search for large grids (one solution, no uniqueness check) ----
+
+// Fill cells forced by naked and hidden singles; returns false on a contradiction
+bool propagateGridSingles(Grid &g) {
+    const int N = g.N;
+    uint64_t full = (N == 64) ? ~0ULL : ((1ULL << N) - 1);
+    vector<uint64_t> rowM(N), colM(N), boxM(N), cand(N*N);
+    auto place = [&](int i, uint64_t bit) {
+        int r = i / N, c = i % N;
+        g.cells[i] = __builtin_ctzll(bit) + 1;
+        rowM[r] |= bit; colM[c] |= bit; boxM[g.boxOf(r,c)] |= bit;
+    };
+    for (int i=0;i<N*N;++i) if (int v = g.cells[i]) place(i, 1ULL << (v-1));
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i=0;i<N*N;++i) {
+            if (g.cells[i]) { cand[i] = 0; continue; }
+            int r = i / N, c = i % N;
+            cand[i] = ~(rowM[r] | colM[c] | boxM[g.boxOf(r,c)]) & full;
+            if (!cand[i]) return false;
+            if (!(cand[i] & (cand[i] - 1))) { place(i, cand[i]); cand[i] = 0; changed = true; }
+        }
+        if (changed) continue;
+        // hidden singles: a digit with exactly one possible cell in a unit
+        for (int u=0; u<3*N && !changed; ++u) {
+            uint64_t once = 0, twice = 0;
+            int idx[64];
+            for (int k=0;k<N;++k) {
+                int r = u < N ? u : (u < 2*N ? k : (u-2*N)/g.n*g.n + k/g.n);
+                int c = u < N ? k : (u < 2*N ? u-N : (u-2*N)%g.n*g.n + k%g.n);
+                idx[k] = r*N + c;
+                twice |= once & cand[idx[k]];
+                once |= cand[idx[k]];
+            }
+            uint64_t unique = once & ~twice;
+            for (int k=0;k<N && unique;++k) if (uint64_t hit = cand[idx[k]] & unique) {
+                if (hit & (hit - 1)) return false; // two digits forced into one cell
+                place(idx[k], hit);
+                unique &= ~hit;
+                changed = true;
+            }
+        }
+    }
+    return true;
+}
+
+struct AnnealResult {
+    bool solved = false;
+    Grid grid;
+    long long restarts = 0;
+    double ms = 0;
+};
+
+// Simulated annealing over box permutations: every box always holds each digit once, moves swap
+// two non-given cells inside a box, and the cost is the number of digits missing from rows and
+// columns. Each thread runs independent restarts; the first one to reach cost 0 wins.
+AnnealResult annealSolve(const Grid &puzzle, int threads, double timeLimitMs, unsigned seed) {
+    AnnealResult res;
+    auto t0 = chrono::steady_clock::now();
+    auto elapsedMs = [&]() { return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count(); };
+    Grid start = puzzle;
+    if (!gridConsistent(start) || !propagateGridSingles(start)) { res.ms = elapsedMs(); return res; }
+
+    const int N = start.N, n = start.n;
+    vector<char> fixedCell(N*N);
+    for (int i=0;i<N*N;++i) fixedCell[i] = start.cells[i] != 0;
+    vector<vector<int>> freeInBox(N);
+    for (int r=0;r<N;++r) for (int c=0;c<N;++c) if (!fixedCell[r*N + c]) freeInBox[start.boxOf(r,c)].push_back(r*N + c);
+    vector<int> movable;
+    for (int b=0;b<N;++b) if (freeInBox[b].size() >= 2) movable.push_back(b);
+    int freeCells = 0;
+    for (auto &v : freeInBox) freeCells += (int)v.size();
+
+    atomic<bool> found(false);
+    atomic<long long> restarts(0);
+    mutex resultMutex;
+
+    auto worker = [&](unsigned wseed) {
+        mt19937 rng(wseed);
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        vector<int> cells;
+        vector<int> rowCnt(N*(N+1)), colCnt(N*(N+1));
+        while (!found.load(memory_order_relaxed) && elapsedMs() < timeLimitMs) {
+            restarts.fetch_add(1, memory_order_relaxed);
+            // random initial assignment: each box gets its missing digits in random order
+            cells = start.cells;
+            for (int b=0;b<N;++b) {
+                vector<char> present(N+1, 0);
+                int br = (b/n)*n, bc = (b%n)*n;
+                for (int r=br;r<br+n;++r) for (int c=bc;c<bc+n;++c) present[cells[r*N + c]] = 1;
+                vector<int> missing;
+                for (int d=1; d<=N; ++d) if (!present[d]) missing.push_back(d);
+                shuffle(missing.begin(), missing.end(), rng);
+                for (int k=0;k<(int)freeInBox[b].size();++k) cells[freeInBox[b][k]] = missing[k];
+            }
+            fill(rowCnt.begin(), rowCnt.end(), 0);
+            fill(colCnt.begin(), colCnt.end(), 0);
+            for (int r=0;r<N;++r) for (int c=0;c<N;++c) { ++rowCnt[r*(N+1) + cells[r*N + c]]; ++colCnt[c*(N+1) + cells[r*N + c]]; }
+            int cost = 0;
+            for (int i=0;i<N;++i) for (int d=1; d<=N; ++d) cost += (rowCnt[i*(N+1) + d] == 0) + (colCnt[i*(N+1) + d] == 0);
+            if (movable.empty()) {
+                if (cost == 0) { lock_guard<mutex> lk(resultMutex); if (!found.exchange(true)) { res.grid = start; res.grid.cells = cells; } }
+                return;
+            }
+
+            // swap two free cells in a random box; returns the cost delta
+            auto swapCells = [&](int a, int b) -> int {
+                int ra = a / N, ca = a % N, rb = b / N, cb = b % N;
+                int x = cells[a], y = cells[b];
+                int delta = 0;
+                if (ra != rb) {
+                    delta += (--rowCnt[ra*(N+1) + x] == 0) - (rowCnt[ra*(N+1) + y]++ == 0);
+                    delta += (--rowCnt[rb*(N+1) + y] == 0) - (rowCnt[rb*(N+1) + x]++ == 0);
+                }
+                if (ca != cb) {
+                    delta += (--colCnt[ca*(N+1) + x] == 0) - (colCnt[ca*(N+1) + y]++ == 0);
+                    delta += (--colCnt[cb*(N+1) + y] == 0) - (colCnt[cb*(N+1) + x]++ == 0);
+                }
+                cells[a] = y; cells[b] = x;
+                return delta;
+            };
+            auto randomMove = [&](int &a, int &b) {
+                const vector<int> &fb = freeInBox[movable[rng() % movable.size()]];
+                int i = rng() % fb.size(), j = rng() % (fb.size() - 1);
+                if (j >= i) ++j;
+                a = fb[i]; b = fb[j];
+            };
+
+            // initial temperature: spread of the cost deltas of random moves
+            double sum = 0, sumSq = 0;
+            for (int k=0;k<200;++k) {
+                int a, b; randomMove(a, b);
+                double d = swapCells(a, b);
+                swapCells(a, b);
+                sum += d; sumSq += d*d;
+            }
+            double temp = max(0.5, sqrt(max(0.0, sumSq/200 - (sum/200)*(sum/200))));
+            long long chain = min<long long>(100000, (long long)freeCells * freeCells);
+            int best = cost, stagnant = 0;
+            while (cost > 0 && stagnant < 40 && !found.load(memory_order_relaxed)) {
+                for (long long k=0; k<chain && cost > 0; ++k) {
+                    int a, b; randomMove(a, b);
+                    int d = swapCells(a, b);
+                    if (d <= 0 || unit(rng) < exp(-d / temp)) cost += d;
+                    else swapCells(a, b);
+                }
+                temp *= 0.99;
+                if (cost < best) { best = cost; stagnant = 0; } else ++stagnant;
+                if (elapsedMs() >= timeLimitMs) break;
+            }
+            if (cost == 0) {
+                lock_guard<mutex> lk(resultMutex);
+                if (!found.exchange(true)) { res.grid = start; res.grid.cells = cells; }
+            }
+        }
+    };
+
+    vector<thread> pool;
+    for (int t=0; t<max(1, threads); ++t) pool.emplace_back(worker, seed + 7919u * t);
+    for (auto &th : pool) th.join();
+    res.solved = found.load();
+    res.restarts = restarts.load();
+    res.ms = elapsedMs();
+    return res;
+}
+
+// Random puzzle of box side n with roughly clueFraction of the cells given (for trying the stochastic solver)
+Grid makeRandomGridPuzzle(int n, double clueFraction, mt19937 &rng) {
+    Grid g;
+    g.n = n; g.N = n*n;
+    int N = g.N;
+    vector<int> digit(N), rowOrder, colOrder;
+    iota(digit.begin(), digit.end(), 1);
+    shuffle(digit.begin(), digit.end(), rng);
+    // permute bands/stacks and rows/cols within them, which preserves validity of the pattern solution
+    auto permuted = [&]() {
+        vector<int> bands(n), order;
+        iota(bands.begin(), bands.end(), 0);
+        shuffle(bands.begin(), bands.end(), rng);
+        for (int b : bands) {
+            vector<int> inner(n);
+            iota(inner.begin(), inner.end(), 0);
+            shuffle(inner.begin(), inner.end(), rng);
+            for (int i : inner) order.push_back(b*n + i);
+        }
+        return order;
+    };
+    rowOrder = permuted();
+    colOrder = permuted();
+    g.cells.assign(N*N, 0);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    for (int r=0;r<N;++r) for (int c=0;c<N;++c) {
+        int rr = rowOrder[r], cc = colOrder[c];
+        int v = digit[(n*(rr%n) + rr/n + cc) % N];
+        if (unit(rng) < clueFraction) g.cells[r*N + c] = v;
+    }
+    return g;
+}
+
+// Read lines from stdin until input holds N*N cells (chars for N <= 9, numbers otherwise)
+string readGridInput(int N, string input = "") {
+    string line;
+    while (true) {
+        int have = 0;
+        if (N <= 9) {
+            for (char ch : input) if (!isspace((unsigned char)ch)) ++have;
+        } else {
+            istringstream in(input);
+            string tok;
+            while (in >> tok) ++have;
+        }
+        if (have >= N*N || !getline(cin, line)) break;
+        input += line + ' ';
+    }
+    return input;
+}
+
+void stochasticSolveMenu(mt19937 &rng) {
+    cout << "Box size n (grid is n*n x n*n, e.g. 5 for 25x25): ";
+    int n;
+    if (!(cin >> n) || n < 2 || n > 8) { cout << "Box size must be 2..8.\n"; return; }
+    int N = n*n;
+    cout << "Enter the " << N << "x" << N << " grid (" << (N <= 9 ? "digits or ." : "numbers, 0 or . for blank")
+         << "), or 'gen' for a random puzzle: ";
+    string line;
+    getline(cin, line);
+    Grid g;
+    string first;
+    while (first.empty() && getline(cin, line)) {
+        for (char ch : line) if (!isspace((unsigned char)ch)) first.push_back(ch);
+    }
+    if (first == "gen") {
+        g = makeRandomGridPuzzle(n, 0.55, rng);
+    } else if (!parseGrid(readGridInput(N, line + ' '), n, g)) {
+        cerr << "Couldn't parse grid.\n";
+        return;
+    }
+    if (!gridConsistent(g)) { cerr << "Puzzle invalid (contradiction detected).\n"; return; }
+    unsigned hw = thread::hardware_concurrency();
+    int threads = hw ? (int)hw : 4;
+    cout << "Input puzzle:\n";
+    printGrid(g);
+    cout << "Annealing with " << threads << " threads (60 s limit)...\n";
+    AnnealResult res = annealSolve(g, threads, 60000, rng());
+    if (!res.solved) { cout << "No solution found within the time limit (" << res.restarts << " restarts).\n"; return; }
+    cout << "Solution (" << res.restarts << " restarts, " << fixed << setprecision(1) << res.ms << " ms):\n";
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+    printGrid(res.grid);
+}
+
+// ---- Benchmark corpora ----
+
+// Read one puzzle per line (81 chars, digits or '.'); lines that don't parse are skipped
+vector<Board> loadCorpus(const string &path) {
+    vector<Board> out;
+    ifstream in(path);
+    string line;
+    while (getline(in, line)) {
+        Board b;
+        if (parseBoard(line, b)) out.push_back(b);
+    }
+    return out;
+}
+
+// Ask for a corpus file, or "gen" to generate puzzles on the spot
+vector<Board> promptCorpus(mt19937 &rng) {
+    cout << "Corpus file (one 81-char puzzle per line) or 'gen': ";
+    string src;
+    if (!(cin >> src)) return {};
+    if (src != "gen") {
+        vector<Board> corpus = loadCorpus(src);
+        cout << "Loaded " << corpus.size() << " puzzles from " << src << "\n";
+        return corpus;
+    }
+    cout << "How many puzzles and which difficulty (e.g. 50 hard): ";
+    int n; string diff;
+    if (!(cin >> n >> diff)) return {};
+    vector<Board> corpus;
+    for (int i=0;i<n;++i) corpus.push_back(generatePuzzle(rng, difficultyToClues(diff)));
+    cout << "Generated " << corpus.size() << " puzzles\n";
+    return corpus;
+}
+
+// ---- Learned value ordering: traces, training, benchmark ----
+
+struct TraceRow {
+    float f[ValueModel::kFeatures];
+    float label; // 1 if the digit is the one in the solution
+};
+
+// Replay each puzzle along its solution, recording features of every candidate at the MRV cell
+vector<TraceRow> collectSolveTraces(const vector<Board> &corpus) {
+    vector<TraceRow> rows;
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    for (const Board &p : corpus) {
+        if (!s.loadBoard(p) || !s.solveOne()) continue;
+        Board solution = s.board;
+        s.loadBoard(p);
+        while (true) {
+            int br = -1, bc = -1, bestCnt = 10, bestMask = 0;
+            for (auto &e : s.empties) {
+                if (s.board[e.first][e.second] != 0) continue;
+                int mask = s.candidatesMask(e.first, e.second);
+                int cnt = __builtin_popcount(mask);
+                if (cnt < bestCnt) { bestCnt = cnt; br = e.first; bc = e.second; bestMask = mask; }
+            }
+            if (br == -1) break;
+            if (bestCnt > 1) {
+                for (int m = bestMask; m; m &= m - 1) {
+                    int bit = m & -m;
+                    TraceRow row;
+                    s.digitFeatures(br, bc, bit, row.f);
+                    row.label = (__builtin_ctz(bit) + 1 == solution[br][bc]) ? 1.0f : 0.0f;
+                    rows.push_back(row);
+                }
+            }
+            s.place(br, bc, solution[br][bc]);
+        }
+    }
+    return rows;
+}
+
+// Fit the model to traces with plain SGD on logistic loss
+void trainValueModel(const vector<TraceRow> &rows, ValueModel &m, int epochs, mt19937 &rng) {
+    const int F = ValueModel::kFeatures, H = ValueModel::kHidden;
+    uniform_real_distribution<float> init(-0.3f, 0.3f);
+    for (int i=0;i<F;++i) for (int j=0;j<H;++j) m.w1[i][j] = init(rng);
+    for (int j=0;j<H;++j) { m.b1[j] = 0.1f; m.w2[j] = init(rng); }
+    m.b2 = 0;
+    vector<int> order(rows.size());
+    iota(order.begin(), order.end(), 0);
+    float lr = 0.05f;
+    for (int ep=0; ep<epochs; ++ep) {
+        shuffle(order.begin(), order.end(), rng);
+        for (int idx : order) {
+            const TraceRow &t = rows[idx];
+            float h[ValueModel::kHidden];
+            float z = m.score(t.f, h);
+            float g = 1.0f / (1.0f + exp(-z)) - t.label; // dLoss/dz
+            for (int j=0;j<H;++j) {
+                float gh = (h[j] > 0) ? g * m.w2[j] : 0.0f;
+                m.w2[j] -= lr * g * h[j];
+                m.b1[j] -= lr * gh;
+                for (int i=0;i<F;++i) m.w1[i][j] -= lr * gh * t.f[i];
+            }
+            m.b2 -= lr * g;
+        }
+        lr *= 0.8f;
+    }
+}
+
+bool writeTraces(const vector<TraceRow> &rows, const string &path) {
+    ofstream out(path);
+    if (!out) return false;
+    for (auto &t : rows) {
+        for (int i=0;i<ValueModel::kFeatures;++i) out << t.f[i] << ',';
+        out << t.label << '\n';
+    }
+    return !out.fail();
+}
+
+// First-solution search and uniqueness check (countSolutions(2)) with and without the model.
+// Ordering only pays off until the first solution: proving uniqueness explores the whole tree anyway.
+void benchValueModel(const vector<Board> &corpus, const ValueModel &model) {
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    for (int limit = 1; limit <= 2; ++limit) {
+        cout << (limit == 1 ? "First solution:\n" : "Uniqueness check:\n");
+        for (int pass = 0; pass < 2; ++pass) {
+            s.model = pass ? &model : nullptr;
+            long long nodes = 0;
+            auto t0 = chrono::steady_clock::now();
+            for (const Board &p : corpus) {
+                if (!s.loadBoard(p)) continue;
+                s.countSolutions(limit);
+                nodes += s.nodes;
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+            cout << (pass ? "  learned order: " : "  ascending:     ") << nodes << " nodes, " << fixed << setprecision(2)
+                 << ms << " ms (" << (corpus.empty() ? 0.0 : ms / corpus.size()) << " ms/puzzle)\n";
+            cout.unsetf(ios::floatfield);
+            cout.precision(6);
+        }
+    }
+}
+
+void valueModelMenu(ValueModel &model, bool &enabled, mt19937 &rng) {
+    cout << "Learned digit ordering is " << (enabled ? "ON" : "OFF") << ". Action (train/load/save/toggle/bench): ";
+    string act;
+    if (!(cin >> act)) return;
+    if (act == "toggle") {
+        enabled = !enabled;
+        cout << "Learned digit ordering " << (enabled ? "enabled" : "disabled") << ".\n";
+    } else if (act == "load" || act == "save") {
+        cout << "Weights file: ";
+        string path; cin >> path;
+        bool ok = (act == "load") ? model.loadFromFile(path) : model.saveToFile(path);
+        cout << (ok ? "Done.\n" : "Failed (missing file or bad format).\n");
+    } else if (act == "train") {
+        vector<Board> corpus = promptCorpus(rng);
+        vector<TraceRow> rows = collectSolveTraces(corpus);
+        if (rows.empty()) { cout << "No branching decisions found in corpus; nothing to train on.\n"; return; }
+        writeTraces(rows, "value_traces.csv");
+        trainValueModel(rows, model, 20, rng);
+        model.saveToFile("value_model.txt");
+        cout << "Trained on " << rows.size() << " decisions (traces in value_traces.csv, weights in value_model.txt).\n";
+    } else if (act == "bench") {
+        benchValueModel(promptCorpus(rng), model);
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+// ---- Adaptive engine selection ----
+
+// Decision stump over one puzzle feature: engine `below` when feature < threshold, else `above`.
+// Defaults route puzzles that singles don't crack to the propagating engine.
+struct EngineSelector {
+    static const int kFeatureCount = 3;
+    // Cut for a stump that always picks `below`: finite, so saveToFile writes a number that reads back
+    static constexpr double kAlwaysBelow = numeric_limits<double>::max();
+    int feature = 1;      // 0 = clues, 1 = emptyAfterSingles, 2 = avgCandidates*10
+    double threshold = 1;
+    Engine below = Engine::Mrv, above = Engine::Propagate;
+
+    static double featureValue(const PuzzleFeatures &f, int which) {
+        switch (which) {
+            case 0: return f.clues;
+            case 1: return f.emptyAfterSingles;
+            default: return f.avgCandidates * 10;
+        }
+    }
+    static const char *featureName(int which) {
+        static const char *names[kFeatureCount] = {"clues", "emptyAfterSingles", "avgCandidates*10"};
+        return names[which];
+    }
+
+    Engine select(const PuzzleFeatures &f) const { return featureValue(f, feature) < threshold ? below : above; }
+
+    string describe() const {
+        if (threshold == kAlwaysBelow) return string("always ") + engineName(below);
+        ostringstream out;
+        out << featureName(feature) << " < " << threshold << " ? " << engineName(below) << " : " << engineName(above);
+        return out.str();
+    }
+
+    bool loadFromFile(const string &path) {
+        ifstream in(path);
+        int f, b, a; double t;
+        if (!(in >> f >> t >> b >> a) || !isfinite(t) || f < 0 || f >= kFeatureCount || b < 0 || b > 2 || a < 0 || a > 2) return false;
+        feature = f; threshold = t; below = (Engine)b; above = (Engine)a;
+        return true;
+    }
+    bool saveToFile(const string &path) const {
+        ofstream out(path);
+        out << setprecision(numeric_limits<double>::max_digits10) << feature << ' ' << threshold << ' ' << (int)below << ' ' << (int)above << '\n';
+        return !out.fail();
+    }
+};
+constexpr double EngineSelector::kAlwaysBelow; // odr-used by calibration; C++11 needs the definition
+
+const Engine kAllEngines[] = {Engine::Mrv, Engine::Propagate, Engine::Learned};
+
+// Time of the option 2 path (uniqueness check, then solve) for one loaded puzzle, in microseconds
+double timeSolvePath(Solver &s, const Board &p) {
+    auto t0 = chrono::steady_clock::now();
+    if (s.loadBoard(p) && s.countSolutions(2) > 0) s.solveOne();
+    return chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+}
+
+// Run every engine on every puzzle and fit the stump that minimizes total time
+EngineSelector calibrateEngineSelector(const vector<Board> &corpus, const ValueModel &model) {
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    vector<PuzzleFeatures> feats;
+    vector<array<double,3>> times;
+    for (const Board &p : corpus) {
+        if (!s.loadBoard(p)) continue;
+        feats.push_back(s.features());
+        array<double,3> t;
+        for (Engine e : kAllEngines) {
+            s.useEngine(e, &model);
+            t[(int)e] = timeSolvePath(s, p);
+        }
+        times.push_back(t);
+    }
+    EngineSelector best;
+    double bestTotal = numeric_limits<double>::infinity();
+    for (int f = 0; f < EngineSelector::kFeatureCount; ++f) {
+        set<double> cuts;
+        for (auto &pf : feats) cuts.insert(EngineSelector::featureValue(pf, f));
+        cuts.insert(EngineSelector::kAlwaysBelow);
+        for (double cut : cuts) for (Engine b : kAllEngines) for (Engine a : kAllEngines) {
+            double total = 0;
+            for (size_t i=0;i<feats.size();++i)
+                total += times[i][(int)(EngineSelector::featureValue(feats[i], f) < cut ? b : a)];
+            if (total < bestTotal) {
+                bestTotal = total;
+                best.feature = f; best.threshold = cut; best.below = b; best.above = a;
+            }
+        }
+    }
+    return best;
+}
+
+void benchEngineSelector(const vector<Board> &corpus, const EngineSelector &sel, const ValueModel &model) {
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    for (int pass = 0; pass <= 3; ++pass) {
+        double total = 0;
+        for (const Board &p : corpus) {
+            if (pass < 3) {
+                s.useEngine(kAllEngines[pass], &model);
+                total += timeSolvePath(s, p);
+            } else {
+                auto t0 = chrono::steady_clock::now();
+                if (!s.loadBoard(p)) continue;
+                s.useEngine(sel.select(s.features()), &model);
+                if (s.countSolutions(2) > 0) s.solveOne();
+                total += chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+            }
+        }
+        cout << "  " << setw(10) << left << (pass < 3 ? engineName(kAllEngines[pass]) : "adaptive") << right
+             << fixed << setprecision(1) << total / 1000 << " ms\n";
+        cout.unsetf(ios::floatfield);
+        cout.precision(6);
+    }
+}
+
+void engineSelectMenu(EngineSelector &sel, bool &enabled, const ValueModel &model, mt19937 &rng) {
+    cout << "Adaptive engine selection is " << (enabled ? "ON" : "OFF") << " (" << sel.describe()
+         << "). Action (calibrate/toggle/bench): ";
+    string act;
+    if (!(cin >> act)) return;
+    if (act == "toggle") {
+        enabled = !enabled;
+        cout << "Adaptive engine selection " << (enabled ? "enabled" : "disabled") << ".\n";
+    } else if (act == "calibrate") {
+        vector<Board> corpus = promptCorpus(rng);
+        if (corpus.empty()) { cout << "Empty corpus.\n"; return; }
+        sel = calibrateEngineSelector(corpus, model);
+        cout << "Learned: " << sel.describe()
+             << (sel.saveToFile("engine_select.txt") ? " (saved to engine_select.txt)\n" : " (couldn't save engine_select.txt)\n");
+    } else if (act == "bench") {
+        benchEngineSelector(promptCorpus(rng), sel, model);
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+// ---- Portfolio racing ----
+
+struct PortfolioConfig {
+    const char *name;
+    Engine engine;
+    bool descending;
+};
+
+const PortfolioConfig kPortfolio[] = {
+    {"mrv", Engine::Mrv, false},
+    {"mrv-desc", Engine::Mrv, true},
+    {"propagate", Engine::Propagate, false},
+    {"propagate-desc", Engine::Propagate, true},
+    {"learned", Engine::Learned, false},
+};
+
+struct PortfolioResult {
+    int count = 0;     // solutions found (<= countLimit)
+    Board solution{};  // first solution of the winning engine (valid when count > 0)
+    const char *winner = "";
+};
+
+// Run every portfolio configuration on the puzzle in its own thread; the first to finish
+// sets the shared stop flag so the others unwind at their next node.
+// The learned configuration only runs when a model is given.
+PortfolioResult portfolioSolve(const Board &p, int countLimit, const ValueModel *model) {
+    PortfolioResult res;
+    atomic<bool> done(false);
+    mutex resultMutex;
+    vector<thread> pool;
+    for (const PortfolioConfig &cfg : kPortfolio) {
+        if (cfg.engine == Engine::Learned && !model) continue;
+        pool.emplace_back([&, cfg]() {
+            PooledSolver pooled;
+            Solver &s = *pooled;
+            if (!s.loadBoard(p)) { done = true; return; } // invalid puzzle: count stays 0
+            s.useEngine(cfg.engine, model);
+            s.descendingDigits = cfg.descending;
+            s.cancel = &done;
+            int cnt = 0;
+            s.solve(countLimit, cnt);
+            if (s.cancelled) return;
+            lock_guard<mutex> lk(resultMutex);
+            if (done.exchange(true)) return;
+            res.count = cnt;
+            res.solution = s.board;
+            res.winner = cfg.name;
+        });
+    }
+    for (auto &th : pool) th.join();
+    return res;
+}
+
+void printLatencyStats(const char *name, vector<double> us, const char *unit = "us") {
+    if (us.empty()) return;
+    sort(us.begin(), us.end());
+    auto pct = [&](double q) { return us[min(us.size() - 1, (size_t)(q * us.size()))]; };
+    double mean = accumulate(us.begin(), us.end(), 0.0) / us.size();
+    cout << "  " << setw(12) << left << name << right << fixed << setprecision(1)
+         << " mean " << setw(9) << mean << ' ' << unit << "  p50 " << setw(9) << pct(0.5) << "  p90 " << setw(9) << pct(0.9)
+         << "  p99 " << setw(9) << pct(0.99) << "  max " << setw(9) << us.back() << '\n';
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+}
+
+// Per-puzzle latency of the uniqueness-check path: single adaptive engine vs. the portfolio race
+void benchPortfolio(const vector<Board> &corpus, const EngineSelector &sel, const ValueModel *model) {
+    vector<double> single, race;
+    map<string,int> wins;
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    for (const Board &p : corpus) {
+        auto t0 = chrono::steady_clock::now();
+        if (!s.loadBoard(p)) continue;
+        Engine e = sel.select(s.features());
+        if (e == Engine::Learned && !model) e = Engine::Mrv;
+        s.useEngine(e, model);
+        s.countSolutions(2);
+        auto t1 = chrono::steady_clock::now();
+        PortfolioResult r = portfolioSolve(p, 2, model);
+        auto t2 = chrono::steady_clock::now();
+        single.push_back(chrono::duration<double, micro>(t1 - t0).count());
+        race.push_back(chrono::duration<double, micro>(t2 - t1).count());
+        ++wins[r.winner];
+    }
+    printLatencyStats("adaptive", single);
+    printLatencyStats("portfolio", race);
+    cout << "  wins:";
+    for (auto &w : wins) cout << ' ' << w.first << '=' << w.second;
+    cout << '\n';
+}
+
+void portfolioMenu(bool &enabled, const EngineSelector &sel, const ValueModel *model, mt19937 &rng) {
+    cout << "Portfolio racing for option 2 is " << (enabled ? "ON" : "OFF") << ". Action (toggle/bench): ";
+    string act;
+    if (!(cin >> act)) return;
+    if (act == "toggle") {
+        enabled = !enabled;
+        cout << "Portfolio racing " << (enabled ? "enabled" : "disabled") << ".\n";
+    } else if (act == "bench") {
+        benchPortfolio(promptCorpus(rng), sel, model);
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+// ---- Randomized restarts ----
+
+// First-solution latency and node distributions: deterministic MRV vs. randomized Luby restarts
+void benchRestarts(const vector<Board> &corpus, long long baseNodes, mt19937 &rng) {
+    vector<double> detUs, detNodes, rstUs, rstNodes;
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    long long restartsTotal = 0;
+    for (const Board &p : corpus) {
+        if (!s.loadBoard(p)) continue;
+        auto t0 = chrono::steady_clock::now();
+        s.solveOne();
+        detUs.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+        detNodes.push_back((double)s.nodes);
+        s.loadBoard(p);
+        int restarts = 0;
+        long long total = 0;
+        t0 = chrono::steady_clock::now();
+        s.solveOneWithRestarts(rng, baseNodes, &restarts, &total);
+        rstUs.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+        rstNodes.push_back((double)total);
+        restartsTotal += restarts;
+    }
+    cout << "Time:\n";
+    printLatencyStats("mrv", detUs);
+    printLatencyStats("luby", rstUs);
+    cout << "Nodes:\n";
+    printLatencyStats("mrv", detNodes, "n");
+    printLatencyStats("luby", rstNodes, "n");
+    cout << "  restarts: " << restartsTotal << " over " << detUs.size() << " puzzles\n";
+}
+
+void restartMenu(bool &enabled, long long &baseNodes, mt19937 &rng) {
+    cout << "Randomized restarts for first-solution solves are " << (enabled ? "ON" : "OFF") << " (base " << baseNodes
+         << " nodes). Action (toggle/base/bench): ";
+    string act;
+    if (!(cin >> act)) return;
+    if (act == "toggle") {
+        enabled = !enabled;
+        cout << "Randomized restarts " << (enabled ? "enabled" : "disabled") << ".\n";
+    } else if (act == "base") {
+        cout << "Nodes per Luby unit: ";
+        long long b;
+        if (cin >> b && b > 0) baseNodes = b;
+    } else if (act == "bench") {
+        benchRestarts(promptCorpus(rng), baseNodes, rng);
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+// ---- Solution sampling ----
+
+struct SolutionSample {
+    vector<Board> solutions;     // up to k diverse solutions (empty if the puzzle has none)
+    array<int,81> digitSets{};   // per cell: bitmask of digits it takes in some solution (exact)
+    vector<int> undetermined;    // cells (r*9+c) with more than one possible digit
+    int solves = 0;              // randomized single-solution searches spent
+    long long coverNodes = 0;    // nodes of the covering search
+};
+
+// Sample solutions of a (possibly non-unique) puzzle without enumerating them all.
+// Randomized single-solution searches seed a pool and the per-cell digit sets. One covering DFS
+// (singles propagation, MRV) then finishes the digit sets: it tries a branching cell's
+// not-yet-seen digits first, adds every solution it reaches, and prunes any node where no placed
+// digit and no remaining candidate is new, since no solution below it can add a (cell, digit)
+// pair. The result is the exact set of undetermined cells; k solutions are picked from the pool
+// by greedy farthest-point selection on Hamming distance (diverse) or at random.
+SolutionSample sampleSolutions(const Board &puzzle, int k, bool diverse, mt19937 &rng) {
+    SolutionSample out;
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    if (!s.loadBoard(puzzle)) return out;
+    vector<Board> pool;
+    unordered_set<uint64_t> seen;
+    auto tryAdd = [&](const Board &p) -> bool {
+        if (!s.loadBoard(p)) return false;
+        s.rng = &rng;
+        int cnt = 0;
+        s.solve(1, cnt);
+        s.rng = nullptr;
+        ++out.solves;
+        if (cnt == 0) return false;
+        for (int i=0;i<81;++i) out.digitSets[i] |= 1 << (s.board[i/9][i%9] - 1);
+        if (seen.insert(s.hash()).second) pool.push_back(s.board);
+        return true;
+    };
+    if (!tryAdd(puzzle)) return out;
+    s.loadBoard(puzzle);
+    if (s.countSolutions(2) == 1) { out.solutions = pool; return out; } // unique: nothing undetermined
+    for (int i = 1; i < max(8, 4*k); ++i) tryAdd(puzzle);
+
+    s.loadBoard(puzzle);
+    function<void()> cover = [&]() {
+        ++out.coverNodes;
+        if (!s.propagateSingles()) return;
+        int best = -1, bestCount = 10;
+        bool news = false;
+        for (int i=0;i<81;++i) {
+            int r = i/9, c = i%9;
+            if (s.board[r][c]) { news = news || !(out.digitSets[i] & (1 << (s.board[r][c] - 1))); continue; }
+            int m = s.candidatesMask(r,c), cnt = __builtin_popcount(m);
+            if (cnt == 0) return;
+            news = news || (m & ~out.digitSets[i]);
+            if (cnt < bestCount) { bestCount = cnt; best = i; }
+        }
+        if (!news) return;
+        if (best < 0) {
+            for (int i=0;i<81;++i) out.digitSets[i] |= 1 << (s.board[i/9][i%9] - 1);
+            if (seen.insert(s.hash()).second) pool.push_back(s.board);
+            return;
+        }
+        int m = s.candidatesMask(best/9, best%9), fresh = m & ~out.digitSets[best];
+        for (int part : {fresh, m & ~fresh}) {
+            for (; part; part &= part - 1) {
+                Solver::TrailMark before = s.mark();
+                s.place(best/9, best%9, __builtin_ctz(part) + 1);
+                cover();
+                s.undoTo(before);
+            }
+        }
+    };
+    cover();
+    for (int i=0;i<81;++i) if (out.digitSets[i] & (out.digitSets[i] - 1)) out.undetermined.push_back(i);
+
+    if (!diverse) {
+        shuffle(pool.begin(), pool.end(), rng);
+        pool.resize(min<size_t>(pool.size(), k));
+        out.solutions = pool;
+        return out;
+    }
+    auto distance = [](const Board &a, const Board &b) {
+        int d = 0;
+        for (int r=0;r<9;++r) for (int c=0;c<9;++c) d += a[r][c] != b[r][c];
+        return d;
+    };
+    vector<int> minDist(pool.size(), INT_MAX);
+    size_t pick = 0;
+    while ((int)out.solutions.size() < k && out.solutions.size() < pool.size()) {
+        out.solutions.push_back(pool[pick]);
+        minDist[pick] = -1;
+        size_t next = 0;
+        int far = -1;
+        for (size_t j=0;j<pool.size();++j) {
+            if (minDist[j] < 0) continue;
+            minDist[j] = min(minDist[j], distance(pool[j], pool[pick]));
+            if (minDist[j] > far) { far = minDist[j]; next = j; }
+        }
+        if (far < 0) break;
+        pick = next;
+    }
+    return out;
+}
+
+void sampleMenu(mt19937 &rng) {
+    cout << "Enter puzzle (81 chars): ";
+    string first;
+    if (!(cin >> first)) return;
+    Board b;
+    if (!parseBoard(readGridInput(9, first), b)) { cerr << "Couldn't parse board.\n"; return; }
+    cout << "How many example solutions, and 'diverse' or 'random' (e.g. 3 diverse): ";
+    int k; string mode;
+    if (!(cin >> k >> mode) || k < 1) return;
+    auto t0 = chrono::steady_clock::now();
+    SolutionSample sample = sampleSolutions(b, k, mode != "random", rng);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    if (sample.solutions.empty()) { cout << "No solutions exist for this puzzle.\n"; return; }
+    cout << sample.undetermined.size() << " undetermined cells (" << sample.solves << " searches, "
+         << sample.coverNodes << " covering nodes, " << fixed
+         << setprecision(1) << ms << " ms):\n";
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+    Board fixedPart{};
+    for (int i=0;i<81;++i) if (!(sample.digitSets[i] & (sample.digitSets[i] - 1))) fixedPart[i/9][i%9] = __builtin_ctz(sample.digitSets[i]) + 1;
+    printBoard(fixedPart);
+    for (int i : sample.undetermined) {
+        cout << "  r" << i/9 + 1 << "c" << i%9 + 1 << ":";
+        for (int m = sample.digitSets[i]; m; m &= m - 1) cout << ' ' << __builtin_ctz(m) + 1;
+        cout << '\n';
+    }
+    for (size_t j=0;j<sample.solutions.size();++j) {
+        cout << "Solution " << j+1 << ":\n";
+        printBoard(sample.solutions[j]);
+    }
+}
+
+// ---- Clue suggestion for non-unique puzzles ----
+
+struct ClueSuggestion {
+    int initialCount = 0;   // countSolutions(2) of the submitted puzzle
+    Board solution{};       // solution the added clues are taken from
+    vector<int> clues;      // cells (r*9+c) to fill from solution
+    bool provenSmallest = false; // every smaller set was checked and rejected
+    long long checks = 0;   // uniqueness checks performed
+};
+
+// Run check(i) for i in [0, n) over worker threads, each with its own Solver loaded with base
+template <class Check>
+void parallelChecks(const Board &base, int n, int threads, Check check) {
+    atomic<int> next(0);
+    auto worker = [&]() {
+        PooledSolver pooled;
+        Solver &s = *pooled;
+        s.loadBoard(base);
+        for (int i; (i = next.fetch_add(1)) < n; ) check(s, i);
+    };
+    vector<thread> pool;
+    for (int t = 0; t < max(1, min(threads, n)); ++t) pool.emplace_back(worker);
+    for (auto &th : pool) th.join();
+}
+
+// Solutions of the loaded puzzle with extra clues (empty cells) filled from sol, capped at limit.
+// Places them incrementally on the already-loaded solver and undoes them, so s is left unchanged.
+long long countWithClues(Solver &s, const Board &sol, const vector<int> &cells, long long limit) {
+    Solver::TrailMark m = s.mark();
+    for (int cell : cells) s.place(cell/9, cell%9, sol[cell/9][cell%9]); // digits from one solution never conflict
+    long long cnt = s.countSolutionsDecomposed(limit);
+    s.undoTo(m);
+    return cnt;
+}
+
+// Find a small set of extra givens (taken from the first solution) that makes the puzzle unique.
+// Only undetermined cells can help. Every alternative solution in the sampler's pool must differ
+// from the chosen solution in some added cell, which prunes candidate sets before the exact
+// uniqueness check (countSolutionsDecomposed on an incrementally placed copy). Greedy selection
+// (the candidate leaving fewest solutions, checked in parallel) gives an upper bound g; sets of
+// size < g are then searched exhaustively while that stays under maxExactChecks.
+ClueSuggestion suggestClues(const Board &puzzle, mt19937 &rng, int threads, long long maxExactChecks = 200000) {
+    ClueSuggestion out;
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    if (!s.loadBoard(puzzle)) return out;
+    out.initialCount = s.countSolutions(2);
+    if (out.initialCount == 0) return out;
+    out.solution = s.board;
+    if (out.initialCount == 1) { out.provenSmallest = true; return out; }
+
+    SolutionSample sample = sampleSolutions(puzzle, 64, true, rng);
+    const Board &sol = out.solution;
+    vector<int> cand = sample.undetermined;
+    // pool solutions other than sol, as "differs from sol" cell sets over cand
+    vector<vector<char>> alt;
+    for (const Board &b : sample.solutions) {
+        vector<char> diff(cand.size());
+        bool any = false;
+        for (size_t j=0;j<cand.size();++j) { diff[j] = b[cand[j]/9][cand[j]%9] != sol[cand[j]/9][cand[j]%9]; any |= diff[j]; }
+        if (any) alt.push_back(diff);
+    }
+    auto hitsAll = [&](const vector<int> &pick) {
+        for (auto &d : alt) {
+            bool hit = false;
+            for (int j : pick) if (d[j]) { hit = true; break; }
+            if (!hit) return false;
+        }
+        return true;
+    };
+    auto cellsOf = [&](const vector<int> &pick) {
+        vector<int> cells;
+        for (int j : pick) cells.push_back(cand[j]);
+        return cells;
+    };
+    atomic<long long> checks(0);
+
+    // greedy: add the candidate that leaves the fewest solutions until unique
+    vector<int> chosen;
+    Board cur = puzzle;
+    while (true) {
+        vector<long long> left(cand.size(), LLONG_MAX);
+        parallelChecks(cur, (int)cand.size(), threads, [&](Solver &w, int j) {
+            int cell = cand[j];
+            if (cur[cell/9][cell%9]) return;
+            left[j] = countWithClues(w, sol, vector<int>(1, cell), 1000);
+            ++checks;
+        });
+        int best = (int)(min_element(left.begin(), left.end()) - left.begin());
+        if (left[best] == LLONG_MAX) break; // nothing left to add (shouldn't happen)
+        chosen.push_back(best);
+        cur[cand[best]/9][cand[best]%9] = sol[cand[best]/9][cand[best]%9];
+        if (left[best] <= 1) break;
+    }
+    // drop clues made redundant by later ones
+    for (size_t i = chosen.size(); i-- > 0; ) {
+        Board without = cur;
+        without[cand[chosen[i]]/9][cand[chosen[i]]%9] = 0;
+        s.loadBoard(without);
+        ++checks;
+        if (s.countSolutionsDecomposed(2) == 1) { cur = without; chosen.erase(chosen.begin() + i); }
+    }
+
+    // exhaustive search for a strictly smaller set, smallest size first
+    int n = (int)cand.size();
+    bool exhausted = true;
+    for (int size = 1; size < (int)chosen.size(); ++size) {
+        // enumerate combinations that hit every pooled alternative
+        vector<vector<int>> combos;
+        vector<int> pick(size);
+        function<bool(int,int)> gen = [&](int at, int from) -> bool {
+            if (at == size) {
+                if (hitsAll(pick)) combos.push_back(pick);
+                return (long long)combos.size() <= maxExactChecks;
+            }
+            for (int j = from; j <= n - (size - at); ++j) {
+                pick[at] = j;
+                if (!gen(at + 1, j + 1)) return false;
+            }
+            return true;
+        };
+        if (!gen(0, 0)) { exhausted = false; break; }
+        atomic<int> found(-1);
+        parallelChecks(puzzle, (int)combos.size(), threads, [&](Solver &w, int i) {
+            if (found.load() >= 0) return;
+            long long cnt = countWithClues(w, sol, cellsOf(combos[i]), 2);
+            ++checks;
+            int expected = -1;
+            if (cnt == 1) found.compare_exchange_strong(expected, i);
+        });
+        if (found.load() >= 0) { chosen = combos[found.load()]; break; }
+    }
+    out.clues = cellsOf(chosen);
+    out.provenSmallest = exhausted;
+    out.checks = checks.load();
+    return out;
+}
+
+void suggestMenu(mt19937 &rng) {
+    cout << "Enter puzzle (81 chars): ";
+    string first;
+    if (!(cin >> first)) return;
+    Board b;
+    if (!parseBoard(readGridInput(9, first), b)) { cerr << "Couldn't parse board.\n"; return; }
+    unsigned hw = thread::hardware_concurrency();
+    auto t0 = chrono::steady_clock::now();
+    ClueSuggestion sug = suggestClues(b, rng, hw ? (int)hw : 4);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    if (sug.initialCount == 0) { cout << "No solutions exist for this puzzle.\n"; return; }
+    if (sug.initialCount == 1) { cout << "Puzzle is already unique.\n"; return; }
+    cout << "Add " << sug.clues.size() << " clue(s)" << (sug.provenSmallest ? " (no smaller set exists)" : " (smallest not proven)")
+         << ", " << sug.checks << " uniqueness checks, " << fixed << setprecision(1) << ms << " ms:\n";
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+    Board fixedPuzzle = b;
+    for (int cell : sug.clues) {
+        int r = cell/9, c = cell%9;
+        cout << "  r" << r+1 << "c" << c+1 << " = " << sug.solution[r][c] << '\n';
+        fixedPuzzle[r][c] = sug.solution[r][c];
+    }
+    printBoard(fixedPuzzle);
+}
+
+// ---- Zobrist hashing overhead ----
+
+// Uniqueness checks over a corpus with the incremental board hash off, on, and on plus a
+// from-scratch recompute at every node (the 81-cell cost a board-keyed cache would otherwise pay;
+// this mode also verifies the incremental value at every node).
+void benchHashing(const vector<Board> &corpus) {
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    const char *names[3] = {"off", "incremental", "recompute"};
+    for (int mode = 0; mode < 3; ++mode) {
+        s.maintainHash = (mode >= 1);
+        s.verifyHash = (mode == 2);
+        s.hashMismatches = 0;
+        long long nodes = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (const Board &p : corpus) {
+            if (!s.loadBoard(p)) continue;
+            s.countSolutions(2);
+            nodes += s.nodes;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        cout << "  " << setw(12) << left << names[mode] << right << fixed << setprecision(2) << setw(9) << ms << " ms, "
+             << nodes << " nodes";
+        if (mode == 2) cout << ", " << s.hashMismatches << " mismatches";
+        cout << '\n';
+        cout.unsetf(ios::floatfield);
+        cout.precision(6);
+    }
+    s.maintainHash = true;
+    s.verifyHash = false;
+}
+
+// ---- Trail undo vs copy-on-branch ----
+
+// Uniqueness checks undoing through the trail vs restoring a per-node snapshot vs copying the
+// compact state into each child, with and without propagation
+void benchTrail(const vector<Board> &corpus) {
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    CopySolver compact;
+    const char *names[6] = {"trail", "copy", "compact", "trail+prop", "copy+prop", "compact+prop"};
+    for (int mode = 0; mode < 6; ++mode) {
+        bool useCompact = (mode % 3 == 2);
+        s.copyOnBranch = (mode % 3 == 1);
+        s.propagate = compact.propagate = (mode >= 3);
+        long long nodes = 0;
+        size_t peakTrail = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (const Board &p : corpus) {
+            if (useCompact) {
+                if (!compact.loadBoard(p)) continue;
+                compact.countSolutions(2);
+                nodes += compact.nodes;
+                continue;
+            }
+            if (!s.loadBoard(p)) continue;
+            s.countSolutions(2);
+            nodes += s.nodes;
+            peakTrail = max(peakTrail, s.trail.capacity());
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        cout << "  " << setw(12) << left << names[mode] << right << fixed << setprecision(2) << setw(9) << ms << " ms, "
+             << nodes << " nodes";
+        if (mode % 3 == 0) cout << ", trail capacity " << peakTrail;
+        cout << '\n';
+        cout.unsetf(ios::floatfield);
+        cout.precision(6);
+    }
+    cout << "  snapshot size: " << sizeof(Solver::Snapshot) << " bytes, compact state: " << sizeof(CompactState)
+         << " bytes, trail entry: " << sizeof(Solver::TrailEntry) << " bytes\n";
+    s.copyOnBranch = false;
+    s.propagate = false;
+}
+
+// ---- Vectorized MRV ----
+
+// Uniqueness checks with the scalar MRV loop over empties vs the vectorized whole-board scan.
+// The vector scan also sees a dead cell anywhere on the board, where the scalar loop stops at
+// the first single, so it can visit fewer nodes.
+void benchMrvScan(const vector<Board> &corpus) {
+    if (!kSimdMrv) { cout << "  vectorized scan not available on this CPU/build\n"; return; }
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    const char *names[4] = {"scalar", "vector", "scalar+prop", "vector+prop"};
+    for (int mode = 0; mode < 4; ++mode) {
+        s.simdMrv = (mode % 2 == 1);
+        s.propagate = (mode >= 2);
+        long long nodes = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (const Board &p : corpus) {
+            if (!s.loadBoard(p)) continue;
+            s.countSolutions(2);
+            nodes += s.nodes;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        cout << "  " << setw(12) << left << names[mode] << right << fixed << setprecision(2) << setw(9) << ms << " ms, "
+             << nodes << " nodes, " << setprecision(1) << ms * 1e6 / max(1LL, nodes) << " ns/node\n";
+        cout.unsetf(ios::floatfield);
+        cout.precision(6);
+    }
+    s.simdMrv = kSimdMrv;
+    s.propagate = false;
+}
+
+// ---- Lane-parallel batches ----
+
+#if defined(__GNUC__)
+#define HAVE_LANE_BATCH 1
+#if defined(__x86_64__) && defined(__linux__) && !defined(__clang__)
+#define HAVE_TARGET_CLONES 1
+#endif
+// Naked/hidden singles for 16 puzzles in lockstep: lane k of cand[i] is the candidate mask of
+// cell i in puzzle k, so every step is one vector operation across the batch (GCC vector
+// extensions; two SSE ops per step on the baseline, one with AVX2). A lane that stops changing
+// simply rides along until the whole batch settles. Propagation is sound, so a lane whose cells
+// all end as singles is the unique solution, a lane with an empty cell has none, and anything
+// else goes to the scalar Solver.
+struct LaneBatch {
+    static const int kLanes = 16;
+    typedef uint16_t Vec __attribute__((vector_size(32)));
+    typedef uint64_t Words __attribute__((vector_size(32)));
+
+    Vec cand[81];
+    Vec done[81]; // all-ones in lanes where the cell's single has been struck from its peers
+    int lanes = 0;
+
+    // The steps are forced inline so the AVX2 clone of propagate() gets AVX2 copies of them
+    __attribute__((always_inline)) static bool any(const Vec &v) {
+        Words w = (Words)v;
+        return (w[0] | w[1] | w[2] | w[3]) != 0;
+    }
+
+    // Lanes past n start without candidates and are ignored by outcome()
+    void load(const Board *puzzles, int n) {
+        lanes = n;
+        for (int i=0;i<81;++i) {
+            for (int k=0;k<kLanes;++k) {
+                int d = k < n ? puzzles[k][i/9][i%9] : 0;
+                cand[i][k] = (uint16_t)(k >= n ? 0 : d ? 1 << (d-1) : 0x1FF);
+            }
+            done[i] = Vec{};
+        }
+    }
+
+    __attribute__((always_inline)) bool nakedSingles() {
+        bool changed = false;
+        for (int i=0;i<81;++i) {
+            Vec v = cand[i];
+            Vec fresh = (Vec)((v & (v - 1)) == 0) & (Vec)(v != 0) & ~done[i];
+            if (!any(fresh)) continue;
+            done[i] |= fresh;
+            Vec keep = ~(v & fresh);
+            const uint8_t *peers = classicPeers.peers[i];
+            for (int j=0;j<20;++j) cand[peers[j]] &= keep;
+            changed = true;
+        }
+        return changed;
+    }
+
+    __attribute__((always_inline)) bool hiddenSingles() {
+        bool changed = false;
+        for (int u=0;u<27;++u) {
+            const uint8_t *cells = classicPeers.units[u];
+            Vec once = Vec{}, twice = Vec{};
+            for (int j=0;j<9;++j) { Vec c = cand[cells[j]]; twice |= once & c; once |= c; }
+            Vec exactly = once & ~twice;
+            if (!any(exactly)) continue;
+            for (int j=0;j<9;++j) {
+                Vec c = cand[cells[j]], h = c & exactly;
+                Vec narrow = (Vec)(h != 0) & (Vec)(h != c);
+                if (!any(narrow)) continue;
+                cand[cells[j]] = (h & narrow) | (c & ~narrow);
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+    // Built for AVX2 as well when the compiler can, picked at load time: the 32-byte vectors are
+    // then single instructions, about twice as fast as the SSE2 pairs
+#if HAVE_TARGET_CLONES
+    __attribute__((target_clones("avx2", "default")))
+#endif
+    void propagate() {
+        while (nakedSingles() || hiddenSingles()) {}
+    }
+
+    // Lanes (bit k) whose grid is fully determined, and lanes with a cell out of candidates
+    void outcome(unsigned &solved, unsigned &broken) const {
+        Vec allSingle = ~Vec{}, anyEmpty = Vec{};
+        for (int i=0;i<81;++i) {
+            Vec v = cand[i];
+            allSingle &= (Vec)((v & (v - 1)) == 0);
+            anyEmpty |= (Vec)(v == 0);
+        }
+        solved = broken = 0;
+        for (int k=0;k<lanes;++k) {
+            if (anyEmpty[k]) broken |= 1u << k;
+            else if (allSingle[k]) solved |= 1u << k;
+        }
+    }
+
+    // Grid of lane k with every single filled in
+    Board board(int k) const {
+        Board b{};
+        for (int i=0;i<81;++i) {
+            int v = cand[i][k];
+            if (v && !(v & (v - 1))) b[i/9][i%9] = __builtin_ctz(v) + 1;
+        }
+        return b;
+    }
+};
+#else
+#define HAVE_LANE_BATCH 0
+#endif
+
+struct BatchStats {
+    long long laneSolved = 0, laneBroken = 0, scalar = 0;
+};
+
+// Solution counts (up to limit) for a batch of puzzles; solutions[i] is filled when counts[i] >= 1.
+// Puzzles go through the lanes 16 at a time and only the undecided ones reach the scalar Solver,
+// which starts from the singles the lanes already placed.
+void batchCountSolutions(const vector<Board> &puzzles, int limit, vector<int> &counts, vector<Board> &solutions,
+                         BatchStats *stats = nullptr) {
+    size_t n = puzzles.size();
+    counts.assign(n, 0);
+    solutions.assign(n, Board{});
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    auto scalar = [&](size_t i, const Board &start) {
+        if (stats) ++stats->scalar;
+        if (!s.loadBoard(start)) return;
+        counts[i] = s.countSolutions(limit);
+        if (counts[i]) solutions[i] = s.board;
+    };
+#if HAVE_LANE_BATCH
+    LaneBatch batch;
+    for (size_t base = 0; base < n; base += LaneBatch::kLanes) {
+        int m = (int)min<size_t>(LaneBatch::kLanes, n - base);
+        batch.load(&puzzles[base], m);
+        batch.propagate();
+        unsigned solved, broken;
+        batch.outcome(solved, broken);
+        for (int k=0;k<m;++k) {
+            if (broken >> k & 1) {
+                if (stats) ++stats->laneBroken;
+            } else if (solved >> k & 1) {
+                counts[base + k] = 1;
+                solutions[base + k] = batch.board(k);
+                if (stats) ++stats->laneSolved;
+            } else {
+                scalar(base + k, batch.board(k));
+            }
+        }
+    }
+#else
+    for (size_t i=0;i<n;++i) scalar(i, puzzles[i]);
+#endif
+}
+
+// Uniqueness checks over a corpus: scalar Solver, scalar singles pass with Solver fallback, and the
+// lane batch. Counts must agree.
+void benchBatch(const vector<Board> &corpus) {
+    if (corpus.empty()) return;
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    vector<int> expect(corpus.size()), counts;
+    vector<Board> solutions;
+    BatchStats stats;
+    for (int mode = 0; mode < 3; ++mode) {
+        auto t0 = chrono::steady_clock::now();
+        size_t mismatches = 0;
+        if (mode == 2) {
+            batchCountSolutions(corpus, 2, counts, solutions, &stats);
+            for (size_t i=0;i<corpus.size();++i) mismatches += counts[i] != expect[i];
+        } else {
+            for (size_t i=0;i<corpus.size();++i) {
+                SinglesSolver singles;
+                int c;
+                if (mode == 1 && singles.load(corpus[i]) && singles.solve()) c = 1;
+                else c = s.loadBoard(corpus[i]) ? s.countSolutions(2) : 0;
+                if (mode == 0) expect[i] = c;
+                else mismatches += c != expect[i];
+            }
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        const char *names[3] = {"solver", "singles+solver", "lanes+solver"};
+        cout << "  " << setw(15) << left << names[mode] << right << fixed << setprecision(2) << setw(9) << ms << " ms, "
+             << setprecision(2) << ms * 1000 / corpus.size() << " us/puzzle";
+        if (mode) cout << ", " << mismatches << " mismatches";
+        cout << '\n';
+        cout.unsetf(ios::floatfield);
+        cout.precision(6);
+    }
+    cout << "  lanes: " << stats.laneSolved << " solved, " << stats.laneBroken << " without solution, " << stats.scalar
+         << " handed to the scalar Solver\n";
+}
+
+// ---- Solution counting ----
+
+// Keep `clues` random givens of a full solution; usually far from unique below ~25 clues
+Board randomClueSubset(mt19937 &rng, int clues) {
+    Board full = generateFullSolution(rng);
+    vector<int> cells(81);
+    iota(cells.begin(), cells.end(), 0);
+    shuffle(cells.begin(), cells.end(), rng);
+    Board b{};
+    for (int i=0;i<clues && i<81;++i) b[cells[i]/9][cells[i]%9] = full[cells[i]/9][cells[i]%9];
+    return b;
+}
+
+struct CountRun {
+    long long count = 0;
+    long long nodes = 0;
+    double ms = 0;
+};
+
+CountRun timedCount(Solver &s, const Board &p, long long limit, bool decompose) {
+    CountRun run;
+    auto t0 = chrono::steady_clock::now();
+    if (s.loadBoard(p)) {
+        run.count = decompose ? s.countSolutionsDecomposed(limit) : s.countSolutions((int)min<long long>(limit, INT_MAX));
+        run.nodes = s.nodes;
+    }
+    run.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    return run;
+}
+
+void printCountRun(const char *name, const CountRun &run) {
+    cout << "  " << setw(10) << left << name << right << setw(10) << run.count << " solutions " << setw(12) << run.nodes
+         << " nodes " << fixed << setprecision(2) << setw(10) << run.ms << " ms\n";
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+}
+
+// Count one puzzle (or a batch of random under-constrained ones) with plain search, the memo
+// table, and component decomposition (with the memo table)
+void countMenu(TranspositionTable &tt, mt19937 &rng) {
+    cout << "Puzzle (81 chars) or 'gen' for random under-constrained grids: ";
+    string first;
+    if (!(cin >> first)) return;
+    vector<Board> puzzles;
+    if (first == "gen") {
+        cout << "How many grids and how many clues (e.g. 5 20): ";
+        int n, clues;
+        if (!(cin >> n >> clues)) return;
+        for (int i=0;i<n;++i) puzzles.push_back(randomClueSubset(rng, clues));
+    } else {
+        Board b;
+        if (!parseBoard(readGridInput(9, first), b)) { cerr << "Couldn't parse board.\n"; return; }
+        puzzles.push_back(b);
+    }
+    cout << "Count limit: ";
+    long long limit;
+    if (!(cin >> limit) || limit < 1) return;
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    const char *names[3] = {"plain", "memo", "decompose"};
+    CountRun sum[3];
+    long long hits = 0;
+    for (const Board &p : puzzles) {
+        CountRun run[3];
+        for (int mode = 0; mode < 3; ++mode) {
+            tt.clear();
+            s.tt = mode ? &tt : nullptr;
+            run[mode] = timedCount(s, p, limit, mode == 2);
+            if (mode) hits += tt.hits;
+            sum[mode].count += run[mode].count; sum[mode].nodes += run[mode].nodes; sum[mode].ms += run[mode].ms;
+        }
+        if (puzzles.size() > 1) cout << "  grid: " << run[0].count << " / " << run[1].count << " / " << run[2].count << " solutions\n";
+    }
+    for (int mode = 0; mode < 3; ++mode) printCountRun(names[mode], sum[mode]);
+    cout << "  table hits: " << hits << " (" << tt.entries.size() << " slots)\n";
+}
+
+// ---- Generate-and-rate pipeline ----
+
+// Blocking FIFO with a capacity. close() wakes every waiter: push fails from then on and pop
+// returns false once the remaining items are drained.
+template <class T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : cap(capacity) {}
+    bool push(T item) {
+        unique_lock<mutex> lk(m);
+        notFull.wait(lk, [&] { return closed || items.size() < cap; });
+        if (closed) return false;
+        items.push_back(move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+    // push without waiting: false if the queue is full or closed
+    bool tryPush(T &item) {
+        lock_guard<mutex> lk(m);
+        if (closed || items.size() >= cap) return false;
+        items.push_back(move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+    bool pop(T &out) {
+        unique_lock<mutex> lk(m);
+        notEmpty.wait(lk, [&] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        out = move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+    void close() {
+        lock_guard<mutex> lk(m);
+        closed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+private:
+    mutex m;
+    condition_variable notFull, notEmpty;
+    deque<T> items;
+    size_t cap;
+    bool closed = false;
+};
+
+struct RatedPuzzle {
+    Board puzzle;
+    TechniqueRating rating;
+};
+
+struct PipelineStats {
+    long long generated = 0;       // candidates produced by the generator stage
+    long long rejectedClues = 0;   // generator stalled above the tier's clue band
+    long long rejectedSingles = 0; // singles-only check disagreed with the tier
+    long long rated = 0;           // candidates that reached full technique rating
+    double genMs = 0, filterMs = 0, rateMs = 0; // busy time per stage, summed over its threads
+    double wallMs = 0;
+};
+
+// Clue target handed to the generator for each tier. Higher tiers need fewer clues to show up at
+// all; the rater decides the actual tier.
+int tierClues(int tier) {
+    static const int clues[4] = {36, 28, 24, 22};
+    return clues[tier];
+}
+const int kClueSlack = 3; // accept generator output up to this many clues above the target
+
+// Generate puzzles of one tier. Generator threads feed a filter thread (clue count, then a
+// singles-only solvability test: easy needs it to succeed, the other tiers need it to fail), which
+// feeds the full technique rater on the calling thread. Most rejects never reach the rater; easy
+// candidates are generated singles-only in the first place.
+// Stops after count accepted puzzles or maxCandidates generated.
+vector<RatedPuzzle> generateRatedPipeline(int count, int tier, int genThreads, unsigned seed, long long maxCandidates,
+                                          PipelineStats &stats) {
+    stats = PipelineStats();
+    auto t0 = chrono::steady_clock::now();
+    BoundedQueue<Board> candidates(64);
+    BoundedQueue<Board> survivors(64);
+    atomic<long long> issued(0);
+    atomic<int> activeGens(max(1, genThreads));
+    mutex statsMutex;
+    auto stageMs = [](chrono::steady_clock::time_point since) {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - since).count();
+    };
+
+    auto generator = [&](unsigned s) {
+        mt19937 rng(s);
+        double ms = 0;
+        long long made = 0;
+        while (issued.fetch_add(1) < maxCandidates) {
+            auto start = chrono::steady_clock::now();
+            Board p = generatePuzzle(rng, tierClues(tier), tier == 0);
+            ms += stageMs(start);
+            ++made;
+            if (!candidates.push(p)) break;
+        }
+        {
+            lock_guard<mutex> lk(statsMutex);
+            stats.genMs += ms;
+            stats.generated += made;
+        }
+        if (--activeGens == 0) candidates.close();
+    };
+    auto filter = [&]() {
+        Board p;
+        while (candidates.pop(p)) {
+            auto start = chrono::steady_clock::now();
+            int clues = 0;
+            for (auto &row : p) for (int v : row) clues += (v != 0);
+            bool pass = clues <= tierClues(tier) + kClueSlack;
+            if (!pass) ++stats.rejectedClues;
+            else if (singlesSolvable(p) != (tier == 0)) { pass = false; ++stats.rejectedSingles; }
+            stats.filterMs += stageMs(start);
+            if (pass && !survivors.push(p)) break;
+        }
+        survivors.close();
+    };
+
+    vector<thread> gens;
+    for (int t=0; t<max(1, genThreads); ++t) gens.emplace_back(generator, seed + 7919u * t);
+    thread filterThread(filter);
+
+    vector<RatedPuzzle> out;
+    Board p;
+    while ((int)out.size() < count && survivors.pop(p)) {
+        auto start = chrono::steady_clock::now();
+        TechniqueRating r = rateTechniques(p);
+        ++stats.rated;
+        if (r.tier() == tier) out.push_back({p, r});
+        stats.rateMs += stageMs(start);
+    }
+    candidates.close(); // unblocks generators and the filter when we stopped early
+    survivors.close();
+    for (auto &th : gens) th.join();
+    filterThread.join();
+    stats.wallMs = stageMs(t0);
+    return out;
+}
+
+// Baseline: generate, then fully rate, one puzzle at a time on the calling thread. Uses the
+// pipeline's generator (singles-only for the easy tier) so the two differ only in scheduling.
+vector<RatedPuzzle> generateRatedSequential(int count, int tier, unsigned seed, long long maxCandidates, PipelineStats &stats) {
+    stats = PipelineStats();
+    auto t0 = chrono::steady_clock::now();
+    mt19937 rng(seed);
+    vector<RatedPuzzle> out;
+    while ((int)out.size() < count && stats.generated < maxCandidates) {
+        auto start = chrono::steady_clock::now();
+        Board p = generatePuzzle(rng, tierClues(tier), tier == 0);
+        ++stats.generated;
+        auto mid = chrono::steady_clock::now();
+        TechniqueRating r = rateTechniques(p);
+        ++stats.rated;
+        if (r.tier() == tier) out.push_back({p, r});
+        stats.genMs += chrono::duration<double, milli>(mid - start).count();
+        stats.rateMs += chrono::duration<double, milli>(chrono::steady_clock::now() - mid).count();
+    }
+    stats.wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    return out;
+}
+
+void printPipelineStats(const char *name, size_t accepted, const PipelineStats &st) {
+    cout << "  " << name << ": " << accepted << " accepted of " << st.generated << " generated (" << st.rejectedClues
+         << " over clue band, " << st.rejectedSingles << " by singles check, " << st.rated << " fully rated)\n";
+    cout << fixed << setprecision(1) << "    wall " << st.wallMs << " ms; busy: generate " << st.genMs
+         << " ms, filter " << st.filterMs << " ms, rate " << st.rateMs << " ms\n";
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+}
+
+void printRating(const TechniqueRating &r) {
+    cout << "Tier " << kTierNames[r.tier()] << ", hardest technique: " << techniqueName(r.hardest) << '\n';
+    for (int t=0;t<kTechniques;++t) if (r.steps[t]) cout << "  " << setw(18) << left << techniqueName((Technique)t) << right << r.steps[t] << '\n';
+}
+
+// Singles-only test vs the uniqueness check it replaces in easy-tier generation
+void benchSinglesTest(const vector<Board> &corpus) {
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    int solvable = 0, unique = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (const Board &p : corpus) solvable += singlesSolvable(p);
+    double singlesMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    t0 = chrono::steady_clock::now();
+    for (const Board &p : corpus) unique += s.loadBoard(p) && s.countSolutions(2) == 1;
+    double countMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    double n = max<size_t>(1, corpus.size());
+    cout << fixed << setprecision(2) << "  singles-only: " << solvable << " solvable, " << singlesMs * 1000 / n << " us/puzzle\n"
+         << "  countSolutions(2): " << unique << " unique, " << countMs * 1000 / n << " us/puzzle\n";
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+}
+
+void pipelineMenu(mt19937 &rng) {
+    cout << "Rated generation. Action (run/bench/rate/singles): ";
+    string act;
+    if (!(cin >> act)) return;
+    if (act == "rate") {
+        cout << "Enter puzzle (81 chars): ";
+        string first;
+        if (!(cin >> first)) return;
+        Board b;
+        if (!parseBoard(readGridInput(9, first), b)) { cerr << "Couldn't parse board.\n"; return; }
+        printRating(rateTechniques(b));
+        cout << (singlesSolvable(b) ? "Solvable by singles alone.\n" : "Not solvable by singles alone.\n");
+        return;
+    }
+    if (act == "singles") {
+        benchSinglesTest(promptCorpus(rng));
+        return;
+    }
+    if (act != "run" && act != "bench") { cout << "Unknown action.\n"; return; }
+    cout << "How many puzzles, tier (easy/medium/hard/expert) and generator threads (e.g. 20 medium 2): ";
+    int n, threads; string tierName;
+    if (!(cin >> n >> tierName >> threads) || n < 1) return;
+    int tier = parseTier(tierName);
+    if (tier < 0) { cout << "Unknown tier.\n"; return; }
+    long long maxCandidates = 500LL * n;
+    unsigned seed = rng();
+    PipelineStats st;
+    vector<RatedPuzzle> out = generateRatedPipeline(n, tier, threads, seed, maxCandidates, st);
+    if (act == "run") for (const RatedPuzzle &rp : out) cout << boardToString(rp.puzzle) << "  " << techniqueName(rp.rating.hardest) << '\n';
+    printPipelineStats("pipeline", out.size(), st);
+    if (act == "bench") {
+        PipelineStats seq;
+        vector<RatedPuzzle> base = generateRatedSequential(n, tier, seed, maxCandidates, seq);
+        printPipelineStats("sequential", base.size(), seq);
+    }
+}
+
+// ---- Deferred uniqueness checks ----
+
+// Background uniqueness checks for puzzles whose first solution was already handed out. Results
+// are kept for the last kKeep checks and can be polled by id; an optional callback runs on the
+// checker thread when a result comes in.
+class DeferredChecks {
+public:
+    using Callback = function<void(long long id, int count)>;
+    static const int kPending = -1, kUnknown = -2;
+
+    explicit DeferredChecks(int threads = 1) : jobs(1024) {
+        for (int t=0; t<max(1, threads); ++t) checkers.emplace_back([this] { run(); });
+    }
+    ~DeferredChecks() {
+        jobs.close();
+        for (auto &th : checkers) th.join();
+    }
+
+    // Queue a check of puzzle; returns its id, or 0 without waiting if the queue is full (the
+    // caller then reports the solve as unchecked; blocking here would stall the HTTP workers
+    // exactly when degrade mode is shedding load)
+    long long submit(const Board &puzzle, Callback cb = nullptr) {
+        long long id;
+        {
+            lock_guard<mutex> lk(m);
+            id = nextId++;
+            results[id] = kPending; // before the push, so a checker that finishes first finds it
+            order.push_back(id);
+        }
+        Job job{id, puzzle, move(cb)};
+        bool queued = jobs.tryPush(job);
+        lock_guard<mutex> lk(m);
+        if (!queued) { // give the slot back (other submits may have queued after it)
+            order.erase(find(order.rbegin(), order.rend(), id).base() - 1);
+            results.erase(id);
+            return 0;
+        }
+        while (order.size() > kKeep) { results.erase(order.front()); order.pop_front(); }
+        return id;
+    }
+
+    // Solutions found (0, 1 or 2 = "at least two"), kPending, or kUnknown for an id not (or no longer) held
+    int poll(long long id) {
+        lock_guard<mutex> lk(m);
+        auto it = results.find(id);
+        return it == results.end() ? kUnknown : it->second;
+    }
+
+private:
+    static const size_t kKeep = 4096;
+    struct Job {
+        long long id;
+        Board puzzle;
+        Callback cb;
+    };
+    BoundedQueue<Job> jobs;
+    vector<thread> checkers;
+    mutex m;
+    map<long long, int> results;
+    deque<long long> order;
+    long long nextId = 1;
+
+    void run() {
+        Job job;
+        while (jobs.pop(job)) {
+            PooledSolver pooled;
+            Solver &s = *pooled;
+            int count = s.loadBoard(job.puzzle) ? s.countSolutions(2) : 0;
+            {
+                lock_guard<mutex> lk(m);
+                auto it = results.find(job.id);
+                if (it != results.end()) it->second = count;
+            }
+            if (job.cb) job.cb(job.id, count);
+        }
+    }
+};
+
+// How a solve handles the uniqueness check. Auto carries on into the check only if the first
+// solution came fast enough that a check of similar cost still fits the latency budget, and
+// defers it otherwise.
+enum class CheckPolicy { Full, Skip, Defer, Auto };
+
+const char *checkPolicyName(CheckPolicy p) {
+    switch (p) {
+        case CheckPolicy::Full: return "full";
+        case CheckPolicy::Skip: return "skip";
+        case CheckPolicy::Defer: return "defer";
+        case CheckPolicy::Auto: return "auto";
+    }
+    return "?";
+}
+
+bool parseCheckPolicy(const string &s, CheckPolicy &out) {
+    for (CheckPolicy p : {CheckPolicy::Full, CheckPolicy::Skip, CheckPolicy::Defer, CheckPolicy::Auto})
+        if (s == checkPolicyName(p)) { out = p; return true; }
+    return false;
+}
+
+struct SolveOutcome {
+    int count = 0;         // solutions found (<= 2); 1 may mean "at least one" when !checked
+    bool checked = false;  // uniqueness was decided before returning
+    long long checkId = 0; // deferred check to poll (0 = none)
+    Board solution;
+};
+
+// Solve the puzzle loaded in s under policy. Full is countSolutions(2) as before; Skip and Defer
+// return the first solution as soon as it is found, and Auto decides at that point whether to
+// continue the same search for a second one.
+SolveOutcome solveWithPolicy(Solver &s, const Board &puzzle, CheckPolicy policy, double budgetMs, DeferredChecks *deferred) {
+    SolveOutcome out;
+    if (policy == CheckPolicy::Full) {
+        out.count = s.countSolutions(2); // leaves the first solution in s.board
+        out.checked = true;
+        out.solution = s.board;
+        return out;
+    }
+    if (policy == CheckPolicy::Auto) {
+        // one countSolutions(2) that stops at the first solution unless it came fast enough for
+        // the rest of the check to fit the budget too; the first solution is never searched twice
+        auto t0 = chrono::steady_clock::now();
+        long long savedLimit = s.nodeLimit;
+        s.onFirstSolution = [&] {
+            double firstMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+            if (firstMs * 2 > budgetMs) s.nodeLimit = s.nodes;
+        };
+        out.count = s.countSolutions(2);
+        out.checked = !s.nodeLimitHit;
+        s.onFirstSolution = nullptr;
+        s.nodeLimit = savedLimit;
+        out.solution = s.board;
+        if (out.checked || !out.count) { out.checked = true; return out; }
+    } else {
+        if (!s.solveOne()) { out.checked = true; return out; }
+        out.count = 1;
+        out.solution = s.board;
+    }
+    if (policy != CheckPolicy::Skip && deferred) {
+        out.checkId = deferred->submit(puzzle);
+    }
+    return out;
+}
+
+// ---- Puzzle reservoir ----
+
+// Ready-made puzzles per difficulty so a request is a dequeue instead of a generatePuzzle call.
+// Background threads refill a level once it drops below the low watermark and keep going until
+// it reaches the high one; stop() (or destruction) saves what's left to path and start() loads it.
+class PuzzleReservoir {
+public:
+    static const int kLevels = 3;
+    static const char *levelName(int level) {
+        static const char *names[kLevels] = {"easy", "medium", "hard"};
+        return names[level];
+    }
+    static int parseLevel(const string &s) {
+        for (int l=0;l<kLevels;++l) if (s == levelName(l)) return l;
+        return -1;
+    }
+
+    explicit PuzzleReservoir(const string &file) : path(file) {}
+    ~PuzzleReservoir() { stop(); }
+
+    bool running() const { return active; } // safe from any thread; start/stop run on one
+
+    void start(size_t lowMark, size_t highMark, int refillThreads) {
+        stop();
+        low = lowMark;
+        high = max(lowMark, highMark);
+        load();
+        stopping = false;
+        for (int l=0;l<kLevels;++l) refilling[l] = levels[l].size() < low;
+        unsigned seed = (unsigned)chrono::high_resolution_clock::now().time_since_epoch().count();
+        for (int t=0; t<max(1, refillThreads); ++t) threads.emplace_back([this, seed, t] { refill(seed + 7919u * t); });
+        active = true;
+    }
+
+    void stop() {
+        if (threads.empty()) return;
+        active = false;
+        {
+            lock_guard<mutex> lk(m);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &th : threads) th.join();
+        threads.clear();
+        save();
+    }
+
+    // O(1) dequeue; false if the level is empty (the caller generates synchronously then)
+    bool take(int level, Board &out) {
+        lock_guard<mutex> lk(m);
+        deque<Board> &q = levels[level];
+        if (q.empty()) { ++misses; return false; }
+        out = q.front();
+        q.pop_front();
+        ++served;
+        if (q.size() < low && !refilling[level]) { refilling[level] = true; wake.notify_one(); }
+        return true;
+    }
+
+    size_t size(int level) {
+        lock_guard<mutex> lk(m);
+        return levels[level].size();
+    }
+
+    atomic<long long> served{0}, misses{0}, generated{0};
+    size_t low = 16, high = 64;
+
+private:
+    string path;
+    mutex m;
+    condition_variable wake;
+    deque<Board> levels[kLevels];
+    bool refilling[kLevels] = {};
+    int inFlight[kLevels] = {}; // puzzles being generated for each level outside the lock
+    bool stopping = false;
+    atomic<bool> active{false};
+    vector<thread> threads;
+
+    void refill(unsigned seed) {
+        mt19937 rng(seed);
+        unique_lock<mutex> lk(m);
+        while (true) {
+            int level = -1;
+            wake.wait(lk, [&] {
+                if (stopping) return true;
+                for (int l=0;l<kLevels;++l) { // level with the fewest puzzles, counting those in flight
+                    if (refilling[l] && levels[l].size() + inFlight[l] >= high) refilling[l] = false;
+                    if (refilling[l] && (level < 0 || levels[l].size() + inFlight[l] < levels[level].size() + inFlight[level])) level = l;
+                }
+                return level >= 0;
+            });
+            if (stopping) return;
+            // claim the slot now so other threads don't push this level past high
+            if (levels[level].size() + ++inFlight[level] >= high) refilling[level] = false;
+            lk.unlock();
+            Board p = generatePuzzle(rng, difficultyToClues(levelName(level)), level == 0);
+            lk.lock();
+            --inFlight[level];
+            levels[level].push_back(p);
+            ++generated;
+        }
+    }
+
+    // Replaces the levels with the saved file (stop() wrote everything that was kept in memory)
+    void load() {
+        for (auto &q : levels) q.clear();
+        ifstream in(path);
+        string name, puzzle;
+        while (in >> name >> puzzle) {
+            int l = parseLevel(name);
+            Board b;
+            if (l >= 0 && parseBoard(puzzle, b)) levels[l].push_back(b);
+        }
+    }
+
+    void save() {
+        ofstream out(path);
+        for (int l=0;l<kLevels;++l) for (const Board &b : levels[l]) out << levelName(l) << ' ' << boardToString(b) << '\n';
+    }
+};
+
+// A puzzle of the named difficulty: from the reservoir when it has one, generated here otherwise
+Board takeOrGenerate(PuzzleReservoir *reservoir, const string &diff, mt19937 &rng) {
+    int level = PuzzleReservoir::parseLevel(diff);
+    Board p;
+    if (reservoir && reservoir->running() && level >= 0 && reservoir->take(level, p)) return p;
+    return generatePuzzle(rng, difficultyToClues(diff), diff == "easy");
+}
+
+void reservoirMenu(PuzzleReservoir &res, mt19937 &rng) {
+    cout << "Puzzle reservoir is " << (res.running() ? "running" : "stopped");
+    if (res.running()) for (int l=0;l<PuzzleReservoir::kLevels;++l) cout << ", " << PuzzleReservoir::levelName(l) << " " << res.size(l);
+    cout << ". Action (start/stop/take/bench): ";
+    string act;
+    if (!(cin >> act)) return;
+    if (act == "start") {
+        cout << "Low and high watermark per difficulty, refill threads (e.g. 16 64 1): ";
+        size_t lowMark, highMark;
+        int threads;
+        if (!(cin >> lowMark >> highMark >> threads)) return;
+        res.start(lowMark, highMark, threads);
+        cout << "Reservoir started.\n";
+    } else if (act == "stop") {
+        res.stop();
+        cout << "Reservoir stopped and saved (" << res.generated << " generated, " << res.served << " served, "
+             << res.misses << " misses).\n";
+    } else if (act == "take") {
+        cout << "Difficulty (easy/medium/hard): ";
+        string diff;
+        if (!(cin >> diff) || PuzzleReservoir::parseLevel(diff) < 0) return;
+        printBoard(takeOrGenerate(&res, diff, rng));
+    } else if (act == "bench") {
+        cout << "Difficulty and number of requests (e.g. hard 50): ";
+        string diff;
+        int n;
+        if (!(cin >> diff >> n) || PuzzleReservoir::parseLevel(diff) < 0) return;
+        vector<double> pooledUs, directUs;
+        long long missesBefore = res.misses;
+        for (int i=0;i<n;++i) {
+            auto t0 = chrono::steady_clock::now();
+            takeOrGenerate(&res, diff, rng);
+            pooledUs.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+            t0 = chrono::steady_clock::now();
+            generatePuzzle(rng, difficultyToClues(diff), diff == "easy");
+            directUs.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+        }
+        printLatencyStats("reservoir", pooledUs);
+        printLatencyStats("generate", directUs);
+        cout << "  " << res.misses - missesBefore << " of " << n << " requests fell back to generating\n";
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+// ---- Jigsaw regions ----
+
+// Nine connected regions of nine cells (the boxes with a few cells traded between neighbours)
+static const char *kSampleJigsaw =
+    "111122233" "111222333" "412223333" "414455566" "444555666" "445556696" "777788896" "777888999" "778889999";
+
+// Region map: 81 non-space symbols, nine distinct ones, each covering nine orthogonally connected
+// cells. Symbols are numbered 0..8 in order of first appearance.
+bool parseRegionMap(const string &s, uint8_t *region, string &err) {
+    string sym;
+    for (char ch : s) if (!isspace((unsigned char)ch)) sym += ch;
+    if (sym.size() != 81) { err = "need 81 region symbols, got " + to_string(sym.size()); return false; }
+    string seen;
+    int size[9] = {};
+    for (int i=0;i<81;++i) {
+        size_t k = seen.find(sym[i]);
+        if (k == string::npos) {
+            if (seen.size() == 9) { err = "more than 9 regions"; return false; }
+            k = seen.size();
+            seen += sym[i];
+        }
+        region[i] = (uint8_t)k;
+        ++size[k];
+    }
+    for (int k=0;k<(int)seen.size();++k) {
+        if (size[k] != 9) { err = string("region '") + seen[k] + "' has " + to_string(size[k]) + " cells"; return false; }
+    }
+    if (seen.size() != 9) { err = "fewer than 9 regions"; return false; }
+    for (int k=0;k<9;++k) {
+        int start = 0;
+        while (region[start] != k) ++start;
+        vector<int> stack(1, start);
+        bool reached[81] = {};
+        reached[start] = true;
+        int count = 0;
+        while (!stack.empty()) {
+            int i = stack.back();
+            stack.pop_back();
+            ++count;
+            int next[4] = {i >= 9 ? i - 9 : -1, i < 72 ? i + 9 : -1, i % 9 ? i - 1 : -1, i % 9 < 8 ? i + 1 : -1};
+            for (int j : next) if (j >= 0 && !reached[j] && region[j] == k) { reached[j] = true; stack.push_back(j); }
+        }
+        if (count != 9) { err = string("region '") + seen[k] + "' is not connected"; return false; }
+    }
+    return true;
+}
+
+// Digits next to the region map (one letter per region)
+void printJigsaw(const Board &b, const RegionLayout &layout) {
+    for (int r=0;r<9;++r) {
+        for (int c=0;c<9;++c) cout << (b[r][c] ? (char)('0' + b[r][c]) : '.') << ' ';
+        cout << "   ";
+        for (int c=0;c<9;++c) cout << (char)('a' + layout.region[r*9 + c]) << ' ';
+        cout << '\n';
+    }
+}
+
+// Same digging as generatePuzzle; the full grid comes from a randomized solve of the empty board,
+// restarted on a Luby schedule since some layouts give long unlucky runs
+Board generateJigsawPuzzle(const RegionLayout &layout, mt19937 &rng, int targetClues = 30) {
+    PooledSolver pooled;
+    Solver &solver = *pooled;
+    solver.layout = &layout;
+    solver.loadBoard(Board{});
+    if (!solver.solveOneWithRestarts(rng, 200)) return Board{};
+    Board puzzle = solver.board;
+    vector<int> positions(81);
+    iota(positions.begin(), positions.end(), 0);
+    shuffle(positions.begin(), positions.end(), rng);
+    int filled = 81;
+    for (int i : positions) {
+        if (filled <= targetClues) break;
+        int old = puzzle[i/9][i%9];
+        puzzle[i/9][i%9] = 0;
+        if (solver.loadBoard(puzzle) && solver.countSolutions(2) == 1) --filled;
+        else puzzle[i/9][i%9] = old;
+    }
+    return puzzle;
+}
+
+// Uniqueness checks on jigsaw puzzles vs classic puzzles with the same clue target
+void benchJigsaw(const RegionLayout &layout, int n, int clues, mt19937 &rng) {
+    vector<Board> jigsaw, classic;
+    for (int i=0;i<n;++i) {
+        jigsaw.push_back(generateJigsawPuzzle(layout, rng, clues));
+        classic.push_back(generatePuzzle(rng, clues));
+    }
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    for (int pass = 0; pass < 2; ++pass) {
+        s.layout = pass ? &layout : &classicLayout;
+        const vector<Board> &corpus = pass ? jigsaw : classic;
+        long long nodes = 0;
+        int unique = 0;
+        auto t0 = chrono::steady_clock::now();
+        for (const Board &p : corpus) {
+            if (!s.loadBoard(p)) continue;
+            unique += s.countSolutions(2) == 1;
+            nodes += s.nodes;
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        cout << "  " << setw(8) << left << (pass ? "jigsaw" : "classic") << right << fixed << setprecision(2) << setw(9) << ms
+             << " ms, " << ms * 1000 / n << " us/puzzle, " << nodes << " nodes, " << unique << "/" << n << " unique\n";
+        cout.unsetf(ios::floatfield);
+        cout.precision(6);
+    }
+}
+
+void jigsawMenu(mt19937 &rng) {
+    cout << "Region map (81 symbols, e.g. 1-9 per region) or 'sample': ";
+    string first, line;
+    if (!(cin >> first)) return;
+    getline(cin, line);
+    string map = first == "sample" ? string(kSampleJigsaw) : readGridInput(9, first + line);
+    uint8_t region[81];
+    string err;
+    if (!parseRegionMap(map, region, err)) { cout << "Bad region map: " << err << "\n"; return; }
+    unique_ptr<RegionLayout> layout(new RegionLayout(region));
+    cout << "Action (solve, gen, bench): ";
+    string action;
+    if (!(cin >> action)) return;
+    if (action == "solve") {
+        cout << "Puzzle (81 chars, digits or .): ";
+        getline(cin, line);
+        Board b;
+        if (!parseBoard(readGridInput(9), b)) { cout << "Couldn't parse board.\n"; return; }
+        PooledSolver pooled;
+        Solver &s = *pooled;
+        s.layout = layout.get();
+        if (!s.loadBoard(b)) { cout << "Puzzle invalid (contradiction detected).\n"; return; }
+        auto t0 = chrono::steady_clock::now();
+        int cnt = s.countSolutions(2);
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+        if (!cnt) { cout << "No solution (" << us << " us).\n"; return; }
+        cout << (cnt == 1 ? "Unique solution" : "Multiple solutions; first one") << " (" << us << " us):\n";
+        printJigsaw(s.board, *layout);
+    } else if (action == "gen") {
+        cout << "Clues (e.g. 30): ";
+        int clues;
+        if (!(cin >> clues)) return;
+        Board p = generateJigsawPuzzle(*layout, rng, clues);
+        printJigsaw(p, *layout);
+        cout << boardToString(p) << '\n';
+    } else if (action == "bench") {
+        cout << "Puzzles and clues (e.g. 200 28): ";
+        int n, clues;
+        if (cin >> n >> clues && n > 0) benchJigsaw(*layout, n, clues, rng);
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+// ---- Killer sudoku ----
+
+// Sets of `size` distinct digits >= d summing to `sum`, counted and indexed in lexicographic order.
+// Evaluated at compile time into kCageCombos; the bounds test keeps the recursion small.
+constexpr int comboCount(int size, int sum, int d) {
+    return size == 0 ? (sum == 0 ? 1 : 0)
+         : (size > 10 - d || sum < size*d + size*(size-1)/2 || sum > size*(19-size)/2) ? 0
+         : comboCount(size - 1, sum - d, d + 1) + comboCount(size, sum, d + 1);
+}
+
+#define KILLER_COUNT_D(n,s) {comboCount(n,s,1), comboCount(n,s,2), comboCount(n,s,3), comboCount(n,s,4), comboCount(n,s,5), \
+    comboCount(n,s,6), comboCount(n,s,7), comboCount(n,s,8), comboCount(n,s,9), comboCount(n,s,10)}
+#define KILLER_COUNT8(n,s) KILLER_COUNT_D(n,s), KILLER_COUNT_D(n,s+1), KILLER_COUNT_D(n,s+2), KILLER_COUNT_D(n,s+3), \
+    KILLER_COUNT_D(n,s+4), KILLER_COUNT_D(n,s+5), KILLER_COUNT_D(n,s+6), KILLER_COUNT_D(n,s+7)
+#define KILLER_COUNT_ROW(n) {KILLER_COUNT8(n,0), KILLER_COUNT8(n,8), KILLER_COUNT8(n,16), KILLER_COUNT8(n,24), \
+    KILLER_COUNT8(n,32), KILLER_COUNT8(n,40)}
+// kComboCount[size][sum][d-1] = comboCount(size, sum, d), so nthCombo doesn't redo the recursion
+constexpr uint8_t kComboCount[10][48][10] = {KILLER_COUNT_ROW(0), KILLER_COUNT_ROW(1), KILLER_COUNT_ROW(2),
+    KILLER_COUNT_ROW(3), KILLER_COUNT_ROW(4), KILLER_COUNT_ROW(5), KILLER_COUNT_ROW(6), KILLER_COUNT_ROW(7),
+    KILLER_COUNT_ROW(8), KILLER_COUNT_ROW(9)};
+
+constexpr int countFrom(int size, int sum, int d) { return sum < 0 || d > 10 ? 0 : kComboCount[size][sum][d - 1]; }
+
+// Digit mask (bit d-1) of the n-th set
+constexpr int nthCombo(int size, int sum, int n, int d) {
+    return size == 0 || n >= countFrom(size, sum, d) ? 0
+         : n < countFrom(size - 1, sum - d, d + 1) ? (1 << (d - 1)) | nthCombo(size - 1, sum - d, n, d + 1)
+         : nthCombo(size, sum, n - countFrom(size - 1, sum - d, d + 1), d + 1);
+}
+
+// Digit sets a cage of each size and sum can hold; no (size, sum) has more than 12
+struct CageCombos {
+    uint8_t count;
+    uint16_t mask[12];
+};
+#define KILLER_COMBOS(n,s) {(uint8_t)countFrom(n,s,1), {(uint16_t)nthCombo(n,s,0,1), (uint16_t)nthCombo(n,s,1,1), \
+    (uint16_t)nthCombo(n,s,2,1), (uint16_t)nthCombo(n,s,3,1), (uint16_t)nthCombo(n,s,4,1), (uint16_t)nthCombo(n,s,5,1), \
+    (uint16_t)nthCombo(n,s,6,1), (uint16_t)nthCombo(n,s,7,1), (uint16_t)nthCombo(n,s,8,1), (uint16_t)nthCombo(n,s,9,1), \
+    (uint16_t)nthCombo(n,s,10,1), (uint16_t)nthCombo(n,s,11,1)}}
+#define KILLER_COMBOS8(n,s) KILLER_COMBOS(n,s), KILLER_COMBOS(n,s+1), KILLER_COMBOS(n,s+2), KILLER_COMBOS(n,s+3), \
+    KILLER_COMBOS(n,s+4), KILLER_COMBOS(n,s+5), KILLER_COMBOS(n,s+6), KILLER_COMBOS(n,s+7)
+#define KILLER_COMBOS_ROW(n) {KILLER_COMBOS8(n,0), KILLER_COMBOS8(n,8), KILLER_COMBOS8(n,16), KILLER_COMBOS8(n,24), \
+    KILLER_COMBOS8(n,32), KILLER_COMBOS8(n,40)}
+constexpr CageCombos kCageCombos[10][48] = {KILLER_COMBOS_ROW(0), KILLER_COMBOS_ROW(1), KILLER_COMBOS_ROW(2),
+    KILLER_COMBOS_ROW(3), KILLER_COMBOS_ROW(4), KILLER_COMBOS_ROW(5), KILLER_COMBOS_ROW(6), KILLER_COMBOS_ROW(7),
+    KILLER_COMBOS_ROW(8), KILLER_COMBOS_ROW(9)};
+static_assert(kCageCombos[2][3].count == 1 && kCageCombos[2][3].mask[0] == 0x3, "1+2 is the only pair summing to 3");
+static_assert(kCageCombos[4][20].count == 12, "the busiest (size, sum) has 12 sets");
+static_assert(kCageCombos[9][45].count == 1 && kCageCombos[9][45].mask[0] == 0x1FF, "a full house uses every digit");
+
+struct Cage {
+    int sum;
+    vector<int> cells;
+};
+
+// Cages plus optional givens (the generator adds givens only when the cages leave the grid ambiguous)
+struct KillerPuzzle {
+    Board givens{};
+    vector<Cage> cages;
+};
+
+// Cells as A1..I9 (row letter, column number)
+string cellName(int i) { return string(1, (char)('A' + i/9)) + (char)('1' + i%9); }
+
+// One token per cage, "sum=A1,A2,B1", and one per given, "C4:7"
+string killerToString(const KillerPuzzle &p) {
+    string out;
+    for (const Cage &cg : p.cages) {
+        out += (out.empty() ? "" : " ") + to_string(cg.sum) + "=";
+        for (size_t k=0;k<cg.cells.size();++k) out += (k ? "," : "") + cellName(cg.cells[k]);
+    }
+    for (int i=0;i<81;++i) if (p.givens[i/9][i%9]) out += " " + cellName(i) + ":" + to_string(p.givens[i/9][i%9]);
+    return out;
+}
+
+bool parseKiller(const string &s, KillerPuzzle &p, string &err) {
+    p = KillerPuzzle();
+    istringstream in(s);
+    string tok;
+    auto parseCell = [](const string &t, size_t at) {
+        if (t.size() < at + 2) return -1;
+        int r = toupper((unsigned char)t[at]) - 'A', c = t[at+1] - '1';
+        return r >= 0 && r < 9 && c >= 0 && c < 9 ? r*9 + c : -1;
+    };
+    while (in >> tok) {
+        size_t eq = tok.find('=');
+        if (eq == string::npos) {
+            int i = parseCell(tok, 0), d = tok.size() == 4 && tok[2] == ':' ? tok[3] - '0' : -1;
+            if (i < 0 || d < 1 || d > 9) { err = "bad token '" + tok + "'"; return false; }
+            p.givens[i/9][i%9] = d;
+            continue;
+        }
+        Cage cg;
+        cg.sum = atoi(tok.substr(0, eq).c_str());
+        for (size_t at = eq + 1; at < tok.size(); at += 3) {
+            int i = parseCell(tok, at);
+            if (i < 0 || (at + 2 < tok.size() && tok[at+2] != ',')) { err = "bad cage '" + tok + "'"; return false; }
+            cg.cells.push_back(i);
+        }
+        p.cages.push_back(cg);
+    }
+    if (p.cages.empty()) { err = "no cages"; return false; }
+    return true;
+}
+
+// Cage constraints on top of the 27 units: a placed digit is struck from its row, column, box and
+// cage-mates, and each sum rule (the cages plus the 45-rule remainders of units) keeps only the
+// digits of the combination sets in kCageCombos that avoid its placed digits and give every open
+// cell a candidate. A digit all surviving sets need is placed once only one cell can take it.
+// Rules are re-checked only when one of their cells changed. Search is MRV over 9-bit masks with
+// the small state copied per child.
+struct KillerSolver {
+    long long nodes = 0;
+    array<Board,2> found; // first two solutions of the last countSolutions()
+
+    // False if cages overlap, can't reach their sum, or the givens conflict
+    bool load(const KillerPuzzle &p) {
+        int cageOf[81];
+        fill(cageOf, cageOf + 81, -1);
+        rules.clear();
+        ruleCells.clear();
+        rootOk = false;
+        for (int k=0;k<(int)p.cages.size();++k) {
+            const Cage &cg = p.cages[k];
+            for (int i : cg.cells) {
+                if (i < 0 || i >= 81 || cageOf[i] >= 0) return false;
+                cageOf[i] = k;
+            }
+            if (!addRule(cg.cells, cg.sum)) return false;
+        }
+        // 45 rule: in each row, column and box, the cells outside the cages lying wholly inside it
+        // sum to 45 minus those cages; being in one unit, they can't repeat a digit either
+        for (int u=0;u<27;++u) {
+            const Bits81 &unit = classicPeers.unitBits[u];
+            auto inside = [&](int k) {
+                return all_of(p.cages[k].cells.begin(), p.cages[k].cells.end(), [&](int i) { return unit.test(i); });
+            };
+            int sum = 45;
+            for (int k=0;k<(int)p.cages.size();++k) if (inside(k)) sum -= p.cages[k].sum;
+            vector<int> rest;
+            for (int k=0;k<9;++k) {
+                int i = classicPeers.units[u][k];
+                if (cageOf[i] < 0 || !inside(cageOf[i])) rest.push_back(i);
+            }
+            if (!rest.empty() && rest.size() < 9 && !addRule(rest, sum)) return false;
+        }
+        for (int i=0;i<81;++i) {
+            near[i] = classicPeers.peerBits[i];
+            if (cageOf[i] >= 0) for (int j : p.cages[cageOf[i]].cells) near[i].set(j);
+            near[i].reset(i);
+            Bits81 list = near[i];
+            peerCount[i] = 0;
+            while (list.any()) peers[i][peerCount[i]++] = (uint8_t)list.popFirst();
+            near[i].set(i);
+        }
+        for (int i=0;i<81;++i) { root.cand[i] = 0x1FF; root.value[i] = 0; }
+        root.dirty = ~Bits81();
+        for (int i=0;i<81;++i) {
+            int d = p.givens[i/9][i%9];
+            if (d && (!(root.cand[i] & (1 << (d-1))) || !place(root, i, d))) return false;
+        }
+        rootOk = true;
+        return true;
+    }
+
+    int countSolutions(int limit) {
+        nodes = 0;
+        int count = 0;
+        if (!rootOk) return 0;
+        State s = root;
+        search(s, limit, count);
+        return count;
+    }
+
+private:
+    struct State {
+        uint16_t cand[81]; // bit d-1: digit d still possible (just the digit once placed)
+        uint8_t value[81];
+        Bits81 dirty;      // cells changed since the sum rules last looked at them
+    };
+    struct SumRule {
+        Bits81 cells;
+        uint16_t first, size; // into ruleCells, which can pass 255 cells (81 caged plus 27 remainders of up to 8)
+        uint8_t sum;
+    };
+    State root;
+    bool rootOk = false;
+    vector<SumRule> rules;
+    vector<uint8_t> ruleCells;
+    Bits81 near[81];       // unit peers, cage-mates and the cell itself
+    uint8_t peers[81][28]; // the same as a list, without the cell: 20 unit peers plus up to 8 cage-mates
+    uint8_t peerCount[81];
+
+    bool addRule(const vector<int> &cells, int sum) {
+        int n = (int)cells.size();
+        if (n < 1 || n > 9 || sum < 0 || sum >= 48 || !kCageCombos[n][sum].count) return false;
+        SumRule r;
+        r.first = (uint16_t)ruleCells.size();
+        r.size = (uint16_t)n;
+        r.sum = (uint8_t)sum;
+        for (int i : cells) { r.cells.set(i); ruleCells.push_back((uint8_t)i); }
+        rules.push_back(r);
+        return true;
+    }
+
+    bool place(State &s, int i, int d) const {
+        int bit = 1 << (d-1);
+        s.value[i] = (uint8_t)d;
+        s.cand[i] = (uint16_t)bit;
+        s.dirty = s.dirty | near[i];
+        for (int k=0;k<peerCount[i];++k) {
+            int p = peers[i][k];
+            if (s.value[p]) { if (s.value[p] == d) return false; continue; }
+            if (!(s.cand[p] &= (uint16_t)~bit)) return false;
+        }
+        return true;
+    }
+
+    // Narrow the open cells of one sum rule; false on a contradiction
+    bool applyRule(State &s, const SumRule &r, bool &changed) const {
+        const uint8_t *cells = &ruleCells[r.first];
+        int placed = 0, left = r.sum, avail = 0, open = 0;
+        uint8_t openCells[9];
+        for (int k=0;k<r.size;++k) {
+            int i = cells[k];
+            if (s.value[i]) { placed |= s.cand[i]; left -= s.value[i]; }
+            else { avail |= s.cand[i]; openCells[open++] = (uint8_t)i; }
+        }
+        if (!open) return left == 0;
+        if (left <= 0 || left >= 48) return false;
+        const CageCombos &cc = kCageCombos[open][left];
+        int allowed = 0, required = 0x1FF;
+        for (int k=0;k<cc.count;++k) {
+            int m = cc.mask[k];
+            if ((m & placed) || (m & ~avail)) continue;
+            bool fits = true;
+            for (int j=0;j<open && fits;++j) fits = (s.cand[openCells[j]] & m) != 0;
+            if (!fits) continue;
+            allowed |= m;
+            required &= m;
+        }
+        if (!allowed) return false;
+        for (int j=0;j<open;++j) {
+            int i = openCells[j];
+            if (!(s.cand[i] & ~allowed)) continue;
+            if (!(s.cand[i] &= (uint16_t)allowed)) return false;
+            s.dirty.set(i);
+            changed = true;
+        }
+        for (int m = required; m; m &= m - 1) {
+            int bit = m & -m, where = -1, n = 0;
+            Bits81 sees = ~Bits81();
+            for (int j=0;j<open;++j) {
+                if (!(s.cand[openCells[j]] & bit)) continue;
+                where = openCells[j];
+                ++n;
+                sees = sees & near[where];
+            }
+            if (!n) return false;
+            if (n == 1 && s.cand[where] != bit) { s.cand[where] = (uint16_t)bit; s.dirty.set(where); changed = true; }
+            // the digit is in one of those cells, so no cell seeing all of them can hold it
+            sees = sees & ~r.cells;
+            while (sees.any()) {
+                int i = sees.popFirst();
+                if (s.value[i] || !(s.cand[i] & bit)) continue;
+                if (!(s.cand[i] &= (uint16_t)~bit)) return false;
+                s.dirty.set(i);
+                changed = true;
+            }
+        }
+        return true;
+    }
+
+    bool propagate(State &s) const {
+        while (true) {
+            bool changed = false;
+            for (int i=0;i<81;++i) {
+                int m = s.cand[i];
+                if (s.value[i] || (m & (m - 1))) continue;
+                if (!m || !place(s, i, __builtin_ctz(m) + 1)) return false;
+                changed = true;
+            }
+            Bits81 dirty = s.dirty;
+            s.dirty = Bits81();
+            for (const SumRule &r : rules) {
+                if ((r.cells & dirty).any() && !applyRule(s, r, changed)) return false;
+            }
+            if (changed) continue;
+            // hidden singles: a digit that fits only one cell of a row, column or box
+            for (int u=0;u<27;++u) {
+                int once = 0, twice = 0;
+                for (int k=0;k<9;++k) { int c = s.cand[classicPeers.units[u][k]]; twice |= once & c; once |= c; }
+                if (once != 0x1FF) return false;
+                int unique = once & ~twice;
+                for (int k=0;k<9 && unique;++k) {
+                    int i = classicPeers.units[u][k], hit = s.cand[i] & unique;
+                    if (!hit || s.value[i]) continue;
+                    if (hit & (hit - 1)) return false;
+                    s.cand[i] = (uint16_t)hit;
+                    s.dirty.set(i);
+                    changed = true;
+                }
+            }
+            if (!changed) return true;
+        }
+    }
+
+    bool search(State &s, int limit, int &count) {
+        ++nodes;
+        if (!propagate(s)) return false;
+        int best = -1, bestCount = 10;
+        for (int i=0;i<81;++i) {
+            if (s.value[i]) continue;
+            int cnt = __builtin_popcount(s.cand[i]);
+            if (cnt < bestCount) { bestCount = cnt; best = i; if (cnt == 2) break; }
+        }
+        if (best < 0) {
+            if (count < 2) for (int i=0;i<81;++i) found[count][i/9][i%9] = s.value[i];
+            return ++count >= limit;
+        }
+        for (int m = s.cand[best]; m; m &= m - 1) {
+            State child = s;
+            if (place(child, best, __builtin_ctz(m) + 1) && search(child, limit, count)) return true;
+        }
+        return false;
+    }
+};
+
+// Random cages over a solved grid: each unassigned cell seeds a cage of 2..maxCage cells grown
+// through orthogonal neighbours without repeating a digit (shapes that get boxed in stay smaller)
+vector<Cage> randomCages(const Board &full, mt19937 &rng, int maxCage) {
+    vector<int> order(81), cageOf(81, -1);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), rng);
+    vector<Cage> cages;
+    for (int seed : order) {
+        if (cageOf[seed] >= 0) continue;
+        Cage cg;
+        cg.cells.push_back(seed);
+        cageOf[seed] = (int)cages.size();
+        int used = 1 << (full[seed/9][seed%9] - 1);
+        int target = 2 + (int)(rng() % (maxCage - 1));
+        while ((int)cg.cells.size() < target) {
+            vector<int> grow;
+            for (int i : cg.cells) {
+                int next[4] = {i >= 9 ? i - 9 : -1, i < 72 ? i + 9 : -1, i % 9 ? i - 1 : -1, i % 9 < 8 ? i + 1 : -1};
+                for (int j : next) if (j >= 0 && cageOf[j] < 0 && !(used & (1 << (full[j/9][j%9] - 1)))) grow.push_back(j);
+            }
+            if (grow.empty()) break;
+            int j = grow[rng() % grow.size()];
+            cg.cells.push_back(j);
+            cageOf[j] = (int)cages.size();
+            used |= 1 << (full[j/9][j%9] - 1);
+        }
+        sort(cg.cells.begin(), cg.cells.end());
+        cg.sum = 0;
+        for (int i : cg.cells) cg.sum += full[i/9][i%9];
+        cages.push_back(cg);
+    }
+    return cages;
+}
+
+// Split a cage into connected pieces: about half of it grown from `from`, the rest by component
+void splitCage(vector<Cage> &cages, int k, int from, const Board &full) {
+    vector<int> cells = cages[k].cells;
+    auto inCage = [&](int j) { return find(cells.begin(), cells.end(), j) != cells.end(); };
+    auto grow = [&](int start, size_t limit, vector<int> &taken) {
+        vector<int> piece(1, start);
+        taken.push_back(start);
+        for (size_t q = 0; q < piece.size() && piece.size() < limit; ++q) {
+            int i = piece[q];
+            int next[4] = {i >= 9 ? i - 9 : -1, i < 72 ? i + 9 : -1, i % 9 ? i - 1 : -1, i % 9 < 8 ? i + 1 : -1};
+            for (int j : next) {
+                if (j < 0 || !inCage(j) || find(taken.begin(), taken.end(), j) != taken.end() || piece.size() >= limit) continue;
+                piece.push_back(j);
+                taken.push_back(j);
+            }
+        }
+        Cage cg;
+        cg.cells = piece;
+        sort(cg.cells.begin(), cg.cells.end());
+        cg.sum = 0;
+        for (int i : cg.cells) cg.sum += full[i/9][i%9];
+        return cg;
+    };
+    vector<int> taken;
+    cages[k] = grow(from, (cells.size() + 1) / 2, taken);
+    for (int i : cells) if (find(taken.begin(), taken.end(), i) == taken.end()) cages.push_back(grow(i, cells.size(), taken));
+}
+
+// Killer puzzle with a unique solution and no givens: random cages over generateFullSolution, then
+// while two solutions remain, split the cage of a cell where they differ. Splitting only adds sum
+// constraints, and a cell alone in its cage is fixed, so this always ends.
+KillerPuzzle generateKiller(mt19937 &rng, int maxCage = 5, int *splits = nullptr) {
+    Board full = generateFullSolution(rng);
+    KillerPuzzle p;
+    p.cages = randomCages(full, rng, maxCage);
+    KillerSolver s;
+    if (splits) *splits = 0;
+    while (s.load(p) && s.countSolutions(2) > 1) {
+        vector<int> differ;
+        for (int i=0;i<81;++i) if (s.found[0][i/9][i%9] != s.found[1][i/9][i%9]) differ.push_back(i);
+        int i = differ[rng() % differ.size()];
+        for (int k=0;k<(int)p.cages.size();++k) {
+            if (find(p.cages[k].cells.begin(), p.cages[k].cells.end(), i) != p.cages[k].cells.end()) { splitCage(p.cages, k, i, full); break; }
+        }
+        if (splits) ++*splits;
+    }
+    return p;
+}
+
+// Generation and uniqueness-check latency over n fresh killers
+void benchKiller(int n, int maxCage, mt19937 &rng) {
+    vector<KillerPuzzle> puzzles;
+    vector<double> genMs, solveUs;
+    long long splits = 0;
+    size_t cages = 0;
+    for (int k=0;k<n;++k) {
+        auto t0 = chrono::steady_clock::now();
+        int split;
+        puzzles.push_back(generateKiller(rng, maxCage, &split));
+        genMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+        splits += split;
+        cages += puzzles.back().cages.size();
+    }
+    KillerSolver s;
+    long long nodes = 0;
+    int unique = 0, underMs = 0;
+    for (const KillerPuzzle &p : puzzles) {
+        auto t0 = chrono::steady_clock::now();
+        int cnt = s.load(p) ? s.countSolutions(2) : 0;
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+        solveUs.push_back(us);
+        unique += cnt == 1;
+        underMs += us < 1000;
+        nodes += s.nodes;
+    }
+    cout << "  " << n << " puzzles, " << (double)cages / n << " cages and " << (double)splits / n << " cage splits on average\n";
+    printLatencyStats("generate", genMs, "ms");
+    printLatencyStats("solve+check", solveUs);
+    cout << "  " << unique << "/" << n << " unique, " << underMs << "/" << n << " checked in under 1 ms, "
+         << (double)nodes / n << " nodes per check\n";
+}
+
+void killerMenu(mt19937 &rng) {
+    cout << "Action (solve, gen, bench): ";
+    string action, line;
+    if (!(cin >> action)) return;
+    if (action == "solve") {
+        cout << "Cages as sum=A1,A2,... tokens (optional givens as C4:7), on one line:\n";
+        getline(cin, line);
+        getline(cin, line);
+        KillerPuzzle p;
+        string err;
+        if (!parseKiller(line, p, err)) { cout << "Couldn't parse killer: " << err << "\n"; return; }
+        KillerSolver s;
+        if (!s.load(p)) { cout << "Invalid cages or givens.\n"; return; }
+        auto t0 = chrono::steady_clock::now();
+        int cnt = s.countSolutions(2);
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+        if (!cnt) { cout << "No solution (" << us << " us).\n"; return; }
+        cout << (cnt == 1 ? "Unique solution" : "Multiple solutions; first one") << " (" << us << " us, " << s.nodes << " nodes):\n";
+        printBoard(s.found[0]);
+    } else if (action == "gen") {
+        cout << "Largest cage (2-9, e.g. 5): ";
+        int maxCage;
+        if (!(cin >> maxCage) || maxCage < 2 || maxCage > 9) { cout << "Cage size must be 2..9.\n"; return; }
+        KillerPuzzle p = generateKiller(rng, maxCage);
+        cout << killerToString(p) << '\n';
+        KillerSolver s;
+        s.load(p);
+        s.countSolutions(1);
+        printBoard(s.found[0]);
+    } else if (action == "bench") {
+        cout << "Puzzles and largest cage (e.g. 200 5): ";
+        int n, maxCage;
+        if (cin >> n >> maxCage && n > 0 && maxCage >= 2 && maxCage <= 9) benchKiller(n, maxCage, rng);
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+// ---- Samurai ----
+
+// Five 9x9 grids in a 21x21 frame: four corner grids and a centre grid sharing one corner box with
+// each. The 369 used cells are numbered row-major through the frame.
+struct SamuraiLayout {
+    static const int kGrids = 5, kCells = 369, kSide = 21;
+    int16_t at[21][21];         // cell index, or -1 outside every grid
+    uint8_t row[369], col[369]; // frame coordinates
+    uint8_t grids[369];         // grids containing the cell: 1, or 2 in a shared box
+    uint8_t grid[369][2], local[369][2]; // each membership as (grid, cell 0..80 of that grid)
+    uint8_t gridBits[369];      // bit g set for each grid containing the cell
+    int16_t units[135][9];      // rows, columns, boxes of each grid (shared boxes appear twice)
+    int16_t shared[5][9];       // shared[g]: the box corner grid g shares with the centre (g != 2)
+    SamuraiLayout() {
+        static const int origin[5][2] = {{0,0}, {0,12}, {6,6}, {12,0}, {12,12}};
+        for (auto &line : at) for (auto &v : line) v = -1;
+        for (int g=0;g<5;++g) for (int l=0;l<81;++l) at[origin[g][0] + l/9][origin[g][1] + l%9] = 0;
+        int n = 0;
+        for (int r=0;r<21;++r) for (int c=0;c<21;++c) {
+            if (at[r][c] < 0) continue;
+            at[r][c] = (int16_t)n;
+            row[n] = (uint8_t)r;
+            col[n] = (uint8_t)c;
+            grids[n++] = 0;
+        }
+        for (int g=0;g<5;++g) for (int l=0;l<81;++l) {
+            int i = at[origin[g][0] + l/9][origin[g][1] + l%9];
+            grid[i][grids[i]] = (uint8_t)g;
+            local[i][grids[i]++] = (uint8_t)l;
+            units[27*g + l/9][l%9] = (int16_t)i;
+            units[27*g + 9 + l%9][l/9] = (int16_t)i;
+            units[27*g + 18 + blockIndex(l/9, l%9)][(l/9)%3*3 + (l%9)%3] = (int16_t)i;
+        }
+        int filled[5] = {};
+        for (int i=0;i<369;++i) {
+            gridBits[i] = 0;
+            for (int k=0;k<grids[i];++k) gridBits[i] |= (uint8_t)(1 << grid[i][k]);
+            if (grids[i] == 2) { int g = grid[i][0] == 2 ? grid[i][1] : grid[i][0]; shared[g][filled[g]++] = (int16_t)i; }
+        }
+    }
+};
+static const SamuraiLayout samurai;
+
+using SamuraiBoard = array<int,369>;
+
+// 369 digits or '.', whitespace ignored (the frame's gaps aren't part of the string)
+bool parseSamurai(const string &s, SamuraiBoard &b) {
+    int n = 0;
+    for (char ch : s) {
+        if (isspace((unsigned char)ch)) continue;
+        if (n == 369 || !(ch == '.' || ch == '0' || (ch >= '1' && ch <= '9'))) return false;
+        b[n++] = ch == '.' ? 0 : ch - '0';
+    }
+    return n == 369;
+}
+
+string samuraiToString(const SamuraiBoard &b) {
+    string s(369, '.');
+    for (int i=0;i<369;++i) if (b[i]) s[i] = (char)('0' + b[i]);
+    return s;
+}
+
+void printSamurai(const SamuraiBoard &b) {
+    for (int r=0;r<21;++r) {
+        string line;
+        for (int c=0;c<21;++c) {
+            int i = samurai.at[r][c];
+            line += i < 0 ? ' ' : b[i] ? (char)('0' + b[i]) : '.';
+            line += ' ';
+        }
+        while (!line.empty() && line.back() == ' ') line.pop_back();
+        cout << line << '\n';
+    }
+}
+
+// Each grid keeps Solver's row/column/box masks; a cell's candidates are what none of its grids
+// use, so a digit placed in a shared box is seen by both grids at once. Naked and hidden singles
+// run over all 135 units, and MRV picks across the whole frame, breaking ties toward shared-box
+// cells: filling those first lets the grids come apart sooner. Once a shared box is full, its
+// corner grid no longer interacts with the centre, so the grids split into independent groups
+// that are counted one after another and multiplied (as countSolutionsDecomposed does for
+// 9x9). This keeps an ambiguous corner from being re-searched under every choice made elsewhere.
+// The ~900-byte state is copied per child.
+struct SamuraiSolver {
+    long long nodes = 0;
+    long long nodeLimit = 0;   // stop after this many nodes (0 = unlimited)
+    bool nodeLimitHit = false;
+    mt19937 *rng = nullptr;    // random digit order and MRV tie-breaking when set
+    SamuraiBoard solution{};   // first solution of the last search
+
+    // False if the givens repeat a digit in some grid's row, column or box
+    bool load(const SamuraiBoard &b) {
+        root = State();
+        root.open = 369;
+        for (int &n : root.gridOpen) n = 81;
+        for (int i=0;i<369;++i) {
+            if (!b[i]) continue;
+            if (!(candidates(root, i) & (1 << (b[i]-1)))) return false;
+            place(root, i, b[i]);
+        }
+        return true;
+    }
+
+    int countSolutions(int limit) {
+        nodes = 0;
+        nodeLimitHit = false;
+        State s = root;
+        int count = countIn(s, 0x1F, limit);
+        if (nodeLimitHit) return 0;
+        if (count) for (int i=0;i<369;++i) solution[i] = s.value[i];
+        return count;
+    }
+
+    // One solution by randomized search, restarted on the Luby schedule of Solver
+    bool solveRandom(mt19937 &r, long long baseNodes) {
+        rng = &r;
+        bool ok = false;
+        for (int run = 1; !ok; ++run) {
+            nodeLimit = Solver::luby(run) * baseNodes;
+            ok = countSolutions(1) > 0;
+            if (!ok && !nodeLimitHit) break;
+        }
+        rng = nullptr;
+        nodeLimit = 0;
+        return ok;
+    }
+
+private:
+    struct State {
+        array<array<int,9>,5> rowMask{}, colMask{}, blockMask{}; // per grid, bit d-1 set if digit d is used
+        uint8_t value[369] = {};
+        int open = 0;
+        int gridOpen[5] = {};  // empty cells per grid
+    };
+    State root;
+
+    static int candidates(const State &s, int i) {
+        int used = 0;
+        for (int k=0;k<samurai.grids[i];++k) {
+            int g = samurai.grid[i][k], r = samurai.local[i][k] / 9, c = samurai.local[i][k] % 9;
+            used |= s.rowMask[g][r] | s.colMask[g][c] | s.blockMask[g][blockIndex(r,c)];
+        }
+        return ~used & 0x1FF;
+    }
+
+    static void place(State &s, int i, int d) {
+        int bit = 1 << (d-1);
+        s.value[i] = (uint8_t)d;
+        --s.open;
+        for (int k=0;k<samurai.grids[i];++k) {
+            int g = samurai.grid[i][k], r = samurai.local[i][k] / 9, c = samurai.local[i][k] % 9;
+            --s.gridOpen[g];
+            s.rowMask[g][r] |= bit;
+            s.colMask[g][c] |= bit;
+            s.blockMask[g][blockIndex(r,c)] |= bit;
+        }
+    }
+
+    // Singles within the grids in mask (other groups are independent and left alone)
+    static bool propagateSingles(State &s, int mask) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i=0;i<369;++i) {
+                if (s.value[i] || !(samurai.gridBits[i] & mask)) continue;
+                int m = candidates(s, i);
+                if (!m) return false;
+                if (m & (m - 1)) continue;
+                place(s, i, __builtin_ctz(m) + 1);
+                changed = true;
+            }
+            if (changed) continue;
+            // hidden singles: a digit that fits only one cell of some grid's row, column or box
+            for (int u=0;u<135;++u) {
+                if (!(mask >> (u / 27) & 1)) continue;
+                const int16_t *cells = samurai.units[u];
+                int cand[9], once = 0, twice = 0, placed = 0;
+                for (int k=0;k<9;++k) {
+                    int i = cells[k];
+                    cand[k] = s.value[i] ? 0 : candidates(s, i);
+                    if (s.value[i]) placed |= 1 << (s.value[i] - 1);
+                    twice |= once & cand[k];
+                    once |= cand[k];
+                }
+                if ((once | placed) != 0x1FF) return false;
+                int unique = once & ~twice;
+                for (int k=0;k<9 && unique;++k) if (int hit = cand[k] & unique) {
+                    if (hit & (hit - 1)) return false;
+                    place(s, cells[k], __builtin_ctz(hit) + 1);
+                    unique &= ~hit;
+                    changed = true;
+                }
+                if (changed) break;
+            }
+        }
+        return true;
+    }
+
+    // Independent groups among the grids in mask that still have empty cells: the centre with
+    // every corner whose shared box isn't full yet, and the other corners on their own
+    static int groups(const State &s, int mask, int *out) {
+        int n = 0, centre = 0;
+        bool centreOpen = (mask & 4) && s.gridOpen[2];
+        for (int g=0;g<5;++g) {
+            if (g == 2 || !(mask >> g & 1) || !s.gridOpen[g]) continue;
+            bool linked = false;
+            for (int k=0;k<9 && centreOpen && !linked;++k) linked = !s.value[samurai.shared[g][k]];
+            if (linked) centre |= 1 << g;
+            else out[n++] = 1 << g;
+        }
+        if (centreOpen) out[n++] = centre | 4;
+        return n;
+    }
+
+    // Solutions (up to limit) for the empty cells of the grids in mask; s is left holding the
+    // first one. Returns 0 with nodeLimitHit set when stopped early.
+    int countIn(State &s, int mask, int limit) {
+        if (nodeLimit && nodes >= nodeLimit) { nodeLimitHit = true; return 0; }
+        ++nodes;
+        if (!propagateSingles(s, mask)) return 0;
+        int group[5];
+        int ng = groups(s, mask, group);
+        if (ng == 0) return 1;
+        if (ng > 1) {
+            long long total = 1;
+            for (int k=0;k<ng;++k) {
+                int c = countIn(s, group[k], limit);
+                if (!c) return 0;
+                total = min<long long>(limit, total * c);
+            }
+            return (int)total;
+        }
+        // score 2*candidates, one less in a shared box, so a shared cell wins ties only
+        int best = -1, bestCount = 20, bestMask = 0, ties = 0;
+        for (int i=0;i<369;++i) {
+            if (s.value[i] || !(samurai.gridBits[i] & group[0])) continue;
+            int m = candidates(s, i), cnt = 2 * __builtin_popcount(m) - (samurai.grids[i] - 1);
+            if (cnt < bestCount) { bestCount = cnt; best = i; bestMask = m; ties = 1; if (cnt == 3 && !rng) break; }
+            else if (rng && cnt == bestCount && (*rng)() % ++ties == 0) { best = i; bestMask = m; }
+        }
+        int digits[9], nd = 0;
+        for (int m = bestMask; m; m &= m - 1) digits[nd++] = __builtin_ctz(m) + 1;
+        if (rng) shuffle(digits, digits + nd, *rng);
+        int count = 0;
+        State first;
+        for (int k=0;k<nd && count < limit && !nodeLimitHit;++k) {
+            State child = s;
+            place(child, best, digits[k]);
+            int c = countIn(child, group[0], limit - count);
+            if (c && !count) first = child;
+            count += c;
+        }
+        if (nodeLimitHit) return 0;
+        if (count) s = first;
+        return count;
+    }
+};
+
+// Unique samurai: a random full frame from restarted randomized search, then clues removed in
+// random order while the puzzle stays unique, down to targetClues
+SamuraiBoard generateSamurai(mt19937 &rng, int targetClues = 120) {
+    SamuraiSolver s;
+    SamuraiBoard puzzle{};
+    s.load(puzzle);
+    if (!s.solveRandom(rng, 2000)) return puzzle;
+    puzzle = s.solution;
+    vector<int> order(369);
+    iota(order.begin(), order.end(), 0);
+    shuffle(order.begin(), order.end(), rng);
+    int clues = 369;
+    for (int i : order) {
+        if (clues <= targetClues) break;
+        int old = puzzle[i];
+        puzzle[i] = 0;
+        if (s.load(puzzle) && s.countSolutions(2) == 1) --clues;
+        else puzzle[i] = old;
+    }
+    return puzzle;
+}
+
+// Generation time and uniqueness-check latency over n fresh samurai puzzles
+void benchSamurai(int n, int clues, mt19937 &rng) {
+    vector<SamuraiBoard> puzzles;
+    vector<double> genMs, checkUs;
+    long long totalClues = 0;
+    for (int k=0;k<n;++k) {
+        auto t0 = chrono::steady_clock::now();
+        puzzles.push_back(generateSamurai(rng, clues));
+        genMs.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count());
+        for (int v : puzzles.back()) totalClues += v != 0;
+    }
+    SamuraiSolver s;
+    long long nodes = 0;
+    int unique = 0;
+    for (const SamuraiBoard &p : puzzles) {
+        auto t0 = chrono::steady_clock::now();
+        int cnt = s.load(p) ? s.countSolutions(2) : 0;
+        checkUs.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+        unique += cnt == 1;
+        nodes += s.nodes;
+    }
+    cout << "  " << n << " puzzles, " << (double)totalClues / n << " clues on average\n";
+    printLatencyStats("generate", genMs, "ms");
+    printLatencyStats("check", checkUs);
+    cout << "  " << unique << "/" << n << " unique, " << (double)nodes / n << " nodes per check\n";
+}
+
+void samuraiMenu(mt19937 &rng) {
+    cout << "Action (solve, gen, bench): ";
+    string action, line;
+    if (!(cin >> action)) return;
+    if (action == "solve") {
+        cout << "Puzzle as 369 digits or '.' (row by row through the 21x21 frame, gaps skipped):\n";
+        getline(cin, line);
+        string input;
+        int have = 0;
+        while (have < 369 && getline(cin, line)) {
+            input += line;
+            for (char ch : line) have += !isspace((unsigned char)ch);
+        }
+        SamuraiBoard b;
+        if (!parseSamurai(input, b)) { cout << "Couldn't parse samurai puzzle.\n"; return; }
+        SamuraiSolver s;
+        if (!s.load(b)) { cout << "Puzzle invalid (contradiction detected).\n"; return; }
+        auto t0 = chrono::steady_clock::now();
+        int cnt = s.countSolutions(2);
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+        if (!cnt) { cout << "No solution (" << us << " us).\n"; return; }
+        cout << (cnt == 1 ? "Unique solution" : "Multiple solutions; first one") << " (" << us << " us, " << s.nodes << " nodes):\n";
+        printSamurai(s.solution);
+    } else if (action == "gen") {
+        cout << "Clues (e.g. 120): ";
+        int clues;
+        if (!(cin >> clues)) return;
+        SamuraiBoard p = generateSamurai(rng, clues);
+        printSamurai(p);
+        cout << samuraiToString(p) << '\n';
+    } else if (action == "bench") {
+        cout << "Puzzles and clues (e.g. 20 120): ";
+        int n, clues;
+        if (cin >> n >> clues && n > 0) benchSamurai(n, clues, rng);
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+// ---- Packed sessions ----
+
+// One live puzzle session in 118 bytes (a loaded Solver is ~5 KB with its buffers): digits two
+// per byte, the unit masks as 16 bits, empty and given cells as 81-bit sets. Moves are checked
+// against the masks directly; anything that needs search goes through a full Solver on demand.
+struct PackedSession {
+    uint8_t cells[41];      // cell i in the low (even i) or high (odd i) nibble; 0 = empty
+    uint8_t open;           // empty cells
+    uint16_t rowMask[9], colMask[9], blockMask[9]; // bit d-1 set if digit d is used
+    uint8_t emptyBits[11];  // bit i: cell i is empty
+    uint8_t givenBits[11];  // bit i: cell i is a given and can't be changed
+
+    static bool bit(const uint8_t *set, int i) { return (set[i >> 3] >> (i & 7)) & 1; }
+    static void setBit(uint8_t *set, int i, bool on) {
+        if (on) set[i >> 3] |= (uint8_t)(1 << (i & 7));
+        else set[i >> 3] &= (uint8_t)~(1 << (i & 7));
+    }
+
+    int get(int i) const { return (cells[i >> 1] >> ((i & 1) * 4)) & 0xF; }
+    bool isGiven(int i) const { return bit(givenBits, i); }
+    int candidates(int i) const {
+        int r = i/9, c = i%9;
+        return get(i) ? 0 : ~(rowMask[r] | colMask[c] | blockMask[blockIndex(r,c)]) & 0x1FF;
+    }
+
+    // Write d (0 clears) into cell i, keeping masks and the empty set in step
+    void put(int i, int d) {
+        int r = i/9, c = i%9, old = get(i);
+        if (old) {
+            uint16_t m = (uint16_t)~(1 << (old-1));
+            rowMask[r] &= m; colMask[c] &= m; blockMask[blockIndex(r,c)] &= m;
+            ++open;
+        }
+        cells[i >> 1] = (uint8_t)((cells[i >> 1] & ((i & 1) ? 0x0F : 0xF0)) | (d << ((i & 1) * 4)));
+        if (d) {
+            uint16_t m = (uint16_t)(1 << (d-1));
+            rowMask[r] |= m; colMask[c] |= m; blockMask[blockIndex(r,c)] |= m;
+            --open;
+        }
+        setBit(emptyBits, i, d == 0);
+    }
+
+    // False if the givens conflict
+    bool load(const Board &b) {
+        memset(this, 0, sizeof *this);
+        open = 81;
+        memset(emptyBits, 0xFF, 10);
+        emptyBits[10] = 1;
+        for (int i=0;i<81;++i) {
+            int d = b[i/9][i%9];
+            if (!d) continue;
+            if (!(candidates(i) & (1 << (d-1)))) return false;
+            put(i, d);
+            setBit(givenBits, i, true);
+        }
+        return true;
+    }
+
+    Board board(bool givensOnly = false) const {
+        Board b{};
+        for (int i=0;i<81;++i) if (!givensOnly || isGiven(i)) b[i/9][i%9] = get(i);
+        return b;
+    }
+
+    // A player's move: d in 1..9 places, 0 erases. Rejects givens and digits already in a unit.
+    bool play(int i, int d) {
+        if (isGiven(i) || d < 0 || d > 9) return false;
+        int old = get(i);
+        if (d && old != d) {
+            put(i, 0);
+            if (!(candidates(i) & (1 << (d-1)))) { put(i, old); return false; }
+        }
+        put(i, d);
+        return true;
+    }
+
+    // Expand into the full engine (fresh masks and empties)
+    bool loadInto(Solver &s, bool givensOnly = false) const { return s.loadBoard(board(givensOnly)); }
+};
+static_assert(sizeof(PackedSession) <= 128, "PackedSession should stay within two cache lines");
+
+// Next move for a session: the open cell with the fewest candidates (from the packed masks) and
+// its digit in the puzzle's solution, which is solved from the givens in a pooled Solver.
+// Returns false if the session has no open cell or the puzzle has no solution.
+bool sessionHint(const PackedSession &ps, int &cell, int &digit) {
+    cell = -1;
+    int best = 10;
+    for (int i=0;i<81;++i) {
+        if (!PackedSession::bit(ps.emptyBits, i)) continue;
+        int cnt = __builtin_popcount(ps.candidates(i));
+        if (cnt < best) { best = cnt; cell = i; }
+    }
+    if (cell < 0) return false;
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    if (!ps.loadInto(s, true) || !s.solveOne()) return false;
+    digit = s.board[cell/9][cell%9];
+    return true;
+}
+
+// Sessions by id in one flat array; closed slots are reused
+class SessionStore {
+public:
+    // Returns the new session's id, or -1 if the puzzle's givens conflict
+    long long open(const Board &puzzle) {
+        PackedSession ps;
+        if (!ps.load(puzzle)) return -1;
+        uint32_t id;
+        if (freeIds.empty()) {
+            id = (uint32_t)slots.size();
+            slots.push_back(ps);
+            live.push_back(true);
+        } else {
+            id = freeIds.back();
+            freeIds.pop_back();
+            slots[id] = ps;
+            live[id] = true;
+        }
+        ++count;
+        return id;
+    }
+    void close(uint32_t id) {
+        if (id >= slots.size() || !live[id]) return;
+        live[id] = false;
+        freeIds.push_back(id);
+        --count;
+    }
+    PackedSession *find(uint32_t id) { return id < slots.size() && live[id] ? &slots[id] : nullptr; }
+    size_t size() const { return count; }
+    size_t bytes() const {
+        return slots.capacity() * sizeof(PackedSession) + freeIds.capacity() * sizeof(uint32_t) + live.capacity() / 8;
+    }
+
+private:
+    vector<PackedSession> slots;
+    vector<bool> live;
+    vector<uint32_t> freeIds;
+    size_t count = 0;
+};
+
+// Bytes one session would cost as a loaded Solver, heap buffers included
+size_t solverSessionBytes(const Board &puzzle) {
+    Solver s;
+    s.loadBoard(puzzle);
+    s.solveOne();
+    return sizeof(Solver) + s.empties.capacity() * sizeof(s.empties[0]) + s.trail.capacity() * sizeof(Solver::TrailEntry);
+}
+
+void benchSessions(int sessions, int moves, mt19937 &rng) {
+    SessionStore store;
+    vector<Board> puzzles;
+    for (int i=0;i<16;++i) puzzles.push_back(generatePuzzle(rng, 30)); // sessions share a few puzzles; only the moves differ
+    for (int i=0;i<sessions;++i) store.open(puzzles[i % puzzles.size()]);
+    size_t solverBytes = solverSessionBytes(puzzles[0]);
+    cout << "  " << store.size() << " sessions: " << store.bytes() << " bytes in the store, " << sizeof(PackedSession)
+         << " bytes per packed session vs ~" << solverBytes << " per Solver (" << fixed << setprecision(1)
+         << (double)solverBytes * sessions / (1 << 20) << " MB for all as Solvers)\n";
+    long long played = 0, hints = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (int k=0;k<moves;++k) {
+        PackedSession *ps = store.find(rng() % sessions);
+        int cell, digit;
+        if (k % 16 == 0) { hints += sessionHint(*ps, cell, digit); continue; }
+        cell = rng() % 81;
+        played += ps->play(cell, 1 + rng() % 9);
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    cout << "  " << moves << " operations (" << played << " accepted moves, " << hints << " hints via a full Solver) in "
+         << ms << " ms, " << setprecision(2) << ms * 1000 / max(1, moves) << " us each\n";
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+}
+
+// ---- HTTP/JSON API ----
+
+#if HAVE_HTTP_SERVER
+
+// Flat JSON field readers for the API's request objects ({"puzzle": "...", "limit": 2}).
+// Strings are taken verbatim up to the closing quote (no escapes: nothing we accept needs them).
+bool jsonField(const string &body, const string &key, string &raw) {
+    size_t k = body.find("\"" + key + "\"");
+    if (k == string::npos) return false;
+    size_t i = body.find_first_not_of(" \t\r\n", k + key.size() + 2);
+    if (i == string::npos || body[i] != ':') return false;
+    i = body.find_first_not_of(" \t\r\n", i + 1);
+    if (i == string::npos) return false;
+    if (body[i] == '"') {
+        size_t end = body.find('"', i + 1);
+        if (end == string::npos) return false;
+        raw = body.substr(i + 1, end - i - 1);
+    } else {
+        size_t end = body.find_first_of(",} \t\r\n", i);
+        raw = body.substr(i, end == string::npos ? string::npos : end - i);
+    }
+    return true;
+}
+
+bool jsonInt(const string &body, const string &key, long long &out) {
+    string raw;
+    if (!jsonField(body, key, raw)) return false;
+    char *end = nullptr;
+    out = strtoll(raw.c_str(), &end, 10);
+    return !raw.empty() && *end == '\0';
+}
+
+struct ApiResponse {
+    int status;
+    string body;
+};
+
+ApiResponse apiError(int status, const char *message) {
+    return {status, string("{\"error\":\"") + message + "\"}"};
+}
+
+bool apiPuzzle(const string &body, Board &b) {
+    string s;
+    return jsonField(body, "puzzle", s) && parseBoard(s, b);
+}
+
+// Shared services the API handlers use; either may be null
+struct ApiContext {
+    PuzzleReservoir *reservoir = nullptr; // /generate by difficulty dequeues from it when running
+    DeferredChecks *deferred = nullptr;   // background uniqueness checks for /solve and /check
+};
+
+ApiResponse apiCheckStatus(long long id, int count) {
+    const char *status = count == DeferredChecks::kPending ? "pending" : count == DeferredChecks::kUnknown ? "unknown"
+                       : count == 0 ? "none" : count == 1 ? "unique" : "multiple";
+    return {200, "{\"id\":" + to_string(id) + ",\"status\":\"" + status + "\"}"};
+}
+
+// One API call, run on a worker thread. degraded (set by admission control under load) makes
+// /solve defer its uniqueness check unless the request asked for "check": "full" explicitly.
+ApiResponse handleApi(const string &method, const string &path, const string &body, const ApiContext &ctx,
+                      bool degraded = false) {
+    static thread_local mt19937 rng((unsigned)chrono::high_resolution_clock::now().time_since_epoch().count() ^
+                                    (unsigned)hash<thread::id>()(this_thread::get_id()));
+    string route = path.substr(0, path.find('?'));
+    if (route == "/generate") {
+        if (method != "GET" && method != "POST") return apiError(405, "method not allowed");
+        long long clues = 0;
+        string diff = "medium";
+        jsonField(body, "difficulty", diff);
+        Board p;
+        if (jsonInt(body, "clues", clues)) p = generatePuzzle(rng, (int)max(17LL, min(81LL, clues)));
+        else p = takeOrGenerate(ctx.reservoir, diff, rng);
+        int given = 0;
+        for (auto &row : p) for (int v : row) given += (v != 0);
+        return {200, "{\"puzzle\":\"" + boardToString(p) + "\",\"clues\":" + to_string(given) + "}"};
+    }
+    if (route == "/check") { // GET /check?id=N or POST {"id": N}
+        long long id = 0;
+        size_t q = path.find("?id=");
+        if (q != string::npos) id = atoll(path.c_str() + q + 4);
+        else if (!jsonInt(body, "id", id)) return apiError(400, "expected a check id");
+        if (!ctx.deferred) return apiCheckStatus(id, DeferredChecks::kUnknown);
+        return apiCheckStatus(id, ctx.deferred->poll(id));
+    }
+    if (route != "/solve" && route != "/count" && route != "/rate") return apiError(404, "unknown endpoint");
+    if (method != "POST") return apiError(405, "method not allowed");
+    Board b;
+    if (!apiPuzzle(body, b)) return apiError(400, "expected a puzzle field of 81 digits or dots");
+    if (route == "/rate") {
+        TechniqueRating r = rateTechniques(b);
+        return {200, string("{\"tier\":\"") + kTierNames[r.tier()] + "\",\"hardest\":\"" + techniqueName(r.hardest) +
+                         "\",\"singles\":" + (singlesSolvable(b) ? "true" : "false") + "}"};
+    }
+    PooledSolver pooled;
+    Solver &s = *pooled;
+    if (!s.loadBoard(b)) return {200, "{\"status\":\"invalid\"}"};
+    if (route == "/count") {
+        long long limit = 2;
+        jsonInt(body, "limit", limit);
+        limit = max(1LL, min(1000000LL, limit));
+        long long n = s.countSolutionsDecomposed(limit);
+        return {200, "{\"count\":" + to_string(n) + ",\"limit\":" + to_string(limit) + "}"};
+    }
+    // /solve: "check" is full (default), skip, defer or auto; auto weighs the check against "budget_ms"
+    string check;
+    long long budget = 0;
+    bool hasBudget = jsonInt(body, "budget_ms", budget);
+    CheckPolicy policy = hasBudget ? CheckPolicy::Auto : CheckPolicy::Full;
+    if (jsonField(body, "check", check) && !parseCheckPolicy(check, policy)) return apiError(400, "unknown check policy");
+    if (degraded && check != "full" && policy != CheckPolicy::Skip) policy = CheckPolicy::Defer;
+    SolveOutcome r = solveWithPolicy(s, b, policy, (double)budget, ctx.deferred);
+    if (r.count == 0) return {200, "{\"status\":\"none\"}"};
+    string json = string("{\"status\":\"") + (!r.checked ? "unchecked" : r.count == 1 ? "unique" : "multiple") +
+                  "\",\"solution\":\"" + boardToString(r.solution) + "\"";
+    if (r.checkId) json += ",\"check_id\":" + to_string(r.checkId);
+    return {200, json + "}"};
+}
+
+const size_t kHttpBuffer = 16384;     // initial per-connection input/output buffer
+const size_t kHttpMaxHeader = 8192;
+const size_t kHttpMaxBody = 65536;
+
+struct HttpMessage {
+    string startLine, body;
+    string client; // X-Client-Id header, if any
+    bool close = false;
+};
+
+// Parse one HTTP/1.1 message (request or response) from buf at pos. Returns 1 and advances pos
+// when a whole message is there, 0 if more bytes are needed, -1 if it is malformed.
+int parseHttpMessage(const string &buf, size_t &pos, HttpMessage &msg) {
+    size_t end = buf.find("\r\n\r\n", pos);
+    if (end == string::npos) return buf.size() - pos > kHttpMaxHeader ? -1 : 0;
+    size_t lineEnd = buf.find("\r\n", pos);
+    msg.startLine = buf.substr(pos, lineEnd - pos);
+    msg.client.clear();
+    msg.close = false;
+    size_t length = 0;
+    for (size_t i = lineEnd + 2; i < end; ) {
+        size_t next = buf.find("\r\n", i);
+        if (next > end) next = end;
+        size_t colon = buf.find(':', i);
+        if (colon < next) {
+            string name = buf.substr(i, colon - i), value = buf.substr(colon + 1, next - colon - 1);
+            for (auto &ch : name) ch = tolower((unsigned char)ch);
+            value.erase(0, value.find_first_not_of(' '));
+            if (name == "content-length") length = strtoul(value.c_str(), nullptr, 10);
+            else if (name == "connection") msg.close = (value == "close" || value == "Close");
+            else if (name == "x-client-id") msg.client = value;
+        }
+        i = next + 2;
+    }
+    if (length > kHttpMaxBody) return -1;
+    if (buf.size() < end + 4 + length) return 0;
+    msg.body = buf.substr(end + 4, length);
+    pos = end + 4 + length;
+    return 1;
+}
+
+void appendHttpResponse(string &out, const ApiResponse &r, bool close) {
+    const char *reason = r.status == 200 ? "OK" : r.status == 400 ? "Bad Request" : r.status == 404 ? "Not Found"
+                       : r.status == 405 ? "Method Not Allowed" : r.status == 503 ? "Service Unavailable" : "Error";
+    out += "HTTP/1.1 " + to_string(r.status) + " " + reason + "\r\nContent-Type: application/json\r\nContent-Length: " +
+           to_string(r.body.size()) + (close ? "\r\nConnection: close\r\n\r\n" : "\r\n\r\n");
+    out += r.body;
+}
+
+bool sendAll(int fd, const string &data) {
+    for (size_t sent = 0; sent < data.size(); ) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Shedding configuration for the server's request queues. A request that finds its queue (or
+// its client's share) full is always rejected with 503; degrade and deadline shed earlier.
+struct AdmissionConfig {
+    size_t queueCap = 256;      // queued requests per cost class
+    size_t perClientCap = 64;   // queued requests per client across classes
+    bool degrade = true;        // /solve defers its uniqueness check once the cheap queue is half full
+    double deadlineMs = 0;      // drop requests that waited longer than this before starting (0 = off)
+    bool separateClasses = true; // false: one queue for everything (for comparison)
+};
+
+// Counts behind /metrics
+struct AdmissionMetrics {
+    atomic<long long> admitted[2], completed[2], shedFull[2];
+    atomic<long long> shedClient{0}, shedDeadline{0}, degraded{0};
+    AdmissionMetrics() {
+        for (int c=0;c<2;++c) { admitted[c] = 0; completed[c] = 0; shedFull[c] = 0; }
+    }
+};
+
+// Request scheduler in front of the workers. Requests are split into cost classes: cheap
+// (/solve, /rate, /generate served from the reservoir) and expensive (/count, generating on the
+// spot). Workers always take cheap work first and at most half of them run expensive work at a
+// time, so a flood of counts can't hold up solves. Within a class, clients (X-Client-Id, else the
+// connection) are served round-robin.
+class AdmissionController {
+public:
+    enum CostClass { Cheap = 0, Expensive = 1 };
+
+    struct Job {
+        string method, path, body, client;
+        int cost = Cheap;
+        bool degraded = false;
+        chrono::steady_clock::time_point enqueued;
+        shared_ptr<promise<ApiResponse>> reply;
+    };
+
+    AdmissionController(int threads, const AdmissionConfig &cfg, const ApiContext &context)
+        : config(cfg), ctx(context), maxExpensive(max(1, threads / 2)) {
+        for (int t=0; t<max(1, threads); ++t) workers.emplace_back([this] { work(); });
+    }
+    ~AdmissionController() {
+        {
+            lock_guard<mutex> lk(m);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto &th : workers) th.join();
+    }
+
+    // Queue a request, or answer it with 503 right away
+    void submit(Job job) {
+        string route = job.path.substr(0, job.path.find('?')); // as handleApi routes it
+        job.cost = (config.separateClasses && isExpensive(route, job.body)) ? Expensive : Cheap;
+        job.enqueued = chrono::steady_clock::now();
+        unique_lock<mutex> lk(m);
+        ClassQueue &q = queues[job.cost];
+        auto mine = perClient.find(job.client); // entries exist only while the client has queued work
+        if (q.size >= config.queueCap) {
+            ++metrics.shedFull[job.cost];
+            lk.unlock();
+            job.reply->set_value(apiError(503, "server busy"));
+            return;
+        }
+        if (mine != perClient.end() && mine->second >= config.perClientCap) {
+            ++metrics.shedClient;
+            lk.unlock();
+            job.reply->set_value(apiError(503, "too many queued requests from this client"));
+            return;
+        }
+        if (config.degrade && route == "/solve" && q.size * 2 >= config.queueCap) { // see handleApi
+            job.degraded = true;
+            ++metrics.degraded;
+        }
+        ++perClient[job.client];
+        ++metrics.admitted[job.cost];
+        deque<Job> &mineQ = q.byClient[job.client];
+        if (mineQ.empty()) q.order.push_back(job.client);
+        mineQ.push_back(move(job));
+        ++q.size;
+        lk.unlock();
+        ready.notify_one();
+    }
+
+    size_t queued(int cost) {
+        lock_guard<mutex> lk(m);
+        return queues[cost].size;
+    }
+
+    AdmissionConfig config;
+    AdmissionMetrics metrics;
+
+private:
+    struct ClassQueue {
+        map<string, deque<Job>> byClient;
+        deque<string> order; // clients with queued work, in round-robin order
+        size_t size = 0;
+    };
+    ApiContext ctx;
+    int maxExpensive;
+    int runningExpensive = 0;
+    mutex m;
+    condition_variable ready;
+    ClassQueue queues[2];
+    map<string, size_t> perClient;
+    bool stopping = false;
+    vector<thread> workers;
+
+    // /count, and /generate unless it asks only for a difficulty the running reservoir has stocked
+    // (a "clues" field always generates on the spot, see handleApi)
+    bool isExpensive(const string &route, const string &body) const {
+        if (route == "/count") return true;
+        if (route != "/generate") return false;
+        long long clues;
+        string diff = "medium";
+        if (jsonInt(body, "clues", clues)) return true;
+        jsonField(body, "difficulty", diff);
+        int level = PuzzleReservoir::parseLevel(diff);
+        return !(ctx.reservoir && ctx.reservoir->running() && level >= 0 && ctx.reservoir->size(level) > 0);
+    }
+
+    Job popFrom(ClassQueue &q) {
+        string client = q.order.front();
+        q.order.pop_front();
+        deque<Job> &mine = q.byClient[client];
+        Job job = move(mine.front());
+        mine.pop_front();
+        if (mine.empty()) q.byClient.erase(client);
+        else q.order.push_back(client);
+        --q.size;
+        if (--perClient[client] == 0) perClient.erase(client);
+        return job;
+    }
+
+    void work() {
+        unique_lock<mutex> lk(m);
+        while (true) {
+            ready.wait(lk, [&] {
+                return stopping || queues[Cheap].size || (queues[Expensive].size && runningExpensive < maxExpensive);
+            });
+            if (stopping) return;
+            int cost = queues[Cheap].size ? Cheap : Expensive;
+            Job job = popFrom(queues[cost]);
+            if (cost == Expensive) ++runningExpensive;
+            lk.unlock();
+            double waitedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - job.enqueued).count();
+            if (config.deadlineMs > 0 && waitedMs > config.deadlineMs) {
+                ++metrics.shedDeadline;
+                job.reply->set_value(apiError(503, "queue deadline exceeded"));
+            } else {
+                ApiResponse r = handleApi(job.method, job.path, job.body, ctx, job.degraded);
+                ++metrics.completed[cost];
+                job.reply->set_value(move(r));
+            }
+            lk.lock();
+            if (cost == Expensive) { --runningExpensive; ready.notify_one(); }
+        }
+    }
+};
+
+// Loopback-only HTTP/1.1 server: one I/O thread per connection parses every complete request in
+// its buffer (pipelining), hands them all to admission control, and writes the responses back in
+// request order with a single send. Connections stay open until the client closes or asks to;
+// past maxConnections, new ones get a 503 and are closed, so idle sockets can't use up threads.
+// GET /metrics is answered on the I/O thread, so it works even when the queues are full.
+class HttpServer {
+public:
+    HttpServer(int threads, PuzzleReservoir *res = nullptr, const AdmissionConfig &cfg = AdmissionConfig())
+        : deferred(1), admission(threads, cfg, makeContext(res)) {}
+    ~HttpServer() { stop(); }
+
+    // Listen on 127.0.0.1:port (0 picks a free port, see boundPort)
+    bool start(int port) {
+        signal(SIGPIPE, SIG_IGN);
+        listenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0) return false;
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)port);
+        socklen_t len = sizeof addr;
+        if (bind(listenFd, (sockaddr *)&addr, sizeof addr) < 0 || listen(listenFd, 128) < 0 ||
+            getsockname(listenFd, (sockaddr *)&addr, &len) < 0) {
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        boundPort = ntohs(addr.sin_port);
+        stopping = false;
+        acceptor = thread([this] { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        if (listenFd < 0) return;
+        stopping = true;
+        acceptor.join();
+        for (auto &c : connections) c->th.join();
+        connections.clear();
+        ::close(listenFd);
+        listenFd = -1;
+    }
+
+    string metricsJson() {
+        AdmissionMetrics &m = admission.metrics;
+        auto pair = [](const atomic<long long> *v) {
+            return "{\"cheap\":" + to_string(v[0].load()) + ",\"expensive\":" + to_string(v[1].load()) + "}";
+        };
+        long long queued[2] = {(long long)admission.queued(0), (long long)admission.queued(1)};
+        return "{\"served\":" + to_string(served.load()) + ",\"admitted\":" + pair(m.admitted) + ",\"completed\":" +
+               pair(m.completed) + ",\"queued\":{\"cheap\":" + to_string(queued[0]) + ",\"expensive\":" +
+               to_string(queued[1]) + "},\"shed\":{\"full\":" + pair(m.shedFull) + ",\"client\":" +
+               to_string(m.shedClient.load()) + ",\"deadline\":" + to_string(m.shedDeadline.load()) +
+               "},\"degraded\":" + to_string(m.degraded.load()) + ",\"refusedConnections\":" + to_string(refused.load()) + "}";
+    }
+
+    int boundPort = 0;
+    size_t maxConnections = 256; // open connections (one thread each); more are answered 503 and closed
+    atomic<long long> served{0}, refused{0};
+    DeferredChecks deferred; // declared before admission: workers may still submit checks while it shuts down
+    AdmissionController admission;
+
+private:
+    struct Connection {
+        thread th;
+        atomic<bool> done{false};
+    };
+    int listenFd = -1;
+    atomic<long long> nextConnection{0};
+
+    ApiContext makeContext(PuzzleReservoir *res) {
+        ApiContext c;
+        c.reservoir = res;
+        c.deferred = &deferred;
+        return c;
+    }
+    atomic<bool> stopping{false};
+    thread acceptor;
+    list<unique_ptr<Connection>> connections; // touched only by the acceptor (and stop() after it joins)
+
+    void acceptLoop() {
+        while (!stopping) {
+            for (auto it = connections.begin(); it != connections.end(); ) { // reap finished connections
+                if ((*it)->done) { (*it)->th.join(); it = connections.erase(it); }
+                else ++it;
+            }
+            pollfd p{listenFd, POLLIN, 0};
+            if (poll(&p, 1, 100) <= 0) continue;
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0) continue;
+            if (connections.size() >= maxConnections) {
+                string out;
+                appendHttpResponse(out, apiError(503, "too many connections"), true);
+                sendAll(fd, out);
+                ::close(fd);
+                ++refused;
+                continue;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            connections.emplace_back(new Connection());
+            Connection *c = connections.back().get();
+            c->th = thread([this, fd, c] { serve(fd); c->done = true; });
+        }
+    }
+
+    void serve(int fd) {
+        string in, out, connClient = "conn" + to_string(nextConnection++);
+        HttpMessage msg;
+        in.reserve(kHttpBuffer);
+        out.reserve(kHttpBuffer);
+        char chunk[kHttpBuffer];
+        vector<future<ApiResponse>> pending;
+        bool open = true;
+        while (open && !stopping) {
+            pollfd p{fd, POLLIN, 0};
+            int ready = poll(&p, 1, 100);
+            if (ready == 0) continue;
+            ssize_t n = ready < 0 ? -1 : recv(fd, chunk, sizeof chunk, 0);
+            if (n <= 0) break;
+            in.append(chunk, n);
+
+            size_t pos = 0;
+            bool close = false;
+            int rc;
+            pending.clear();
+            while (!close && (rc = parseHttpMessage(in, pos, msg)) != 0) {
+                AdmissionController::Job job;
+                job.reply = make_shared<promise<ApiResponse>>();
+                pending.push_back(job.reply->get_future());
+                if (rc < 0) { job.reply->set_value(apiError(400, "malformed request")); close = true; break; }
+                close = msg.close;
+                size_t sp1 = msg.startLine.find(' '), sp2 = msg.startLine.find(' ', sp1 + 1);
+                job.method = msg.startLine.substr(0, sp1);
+                job.path = sp1 == string::npos ? "" : msg.startLine.substr(sp1 + 1, sp2 - sp1 - 1);
+                if (job.path == "/metrics") {
+                    job.reply->set_value(job.method == "GET" ? ApiResponse{200, metricsJson()} : apiError(405, "method not allowed"));
+                    continue;
+                }
+                job.body = msg.body;
+                job.client = msg.client.empty() ? connClient : msg.client;
+                admission.submit(move(job));
+            }
+            in.erase(0, pos);
+
+            out.clear();
+            for (size_t i=0;i<pending.size();++i) appendHttpResponse(out, pending[i].get(), close && i + 1 == pending.size());
+            served += pending.size();
+            if (!sendAll(fd, out) || close) open = false;
+        }
+        ::close(fd);
+    }
+};
+
+// ---- Load-test client ----
+
+struct LoadTestResult {
+    long long ok = 0, errors = 0;
+    double wallMs = 0;
+    vector<double> latencyUs; // per request: batch sent -> its response parsed
+};
+
+// `connections` keep-alive connections to 127.0.0.1:port, each sending requestsPerConn requests
+// in pipelined batches of `depth`; makeBody(i) gives the JSON body of the i-th request overall
+LoadTestResult runLoadTest(int port, int connections, int requestsPerConn, int depth, const string &method,
+                           const string &path, const function<string(int)> &makeBody) {
+    LoadTestResult res;
+    mutex resultMutex;
+    auto t0 = chrono::steady_clock::now();
+    auto client = [&](int id) {
+        vector<double> lat;
+        long long ok = 0, errors = 0;
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t)port);
+        if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof addr) < 0) {
+            errors = requestsPerConn;
+        } else {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+            string out, in;
+            HttpMessage msg;
+            out.reserve(kHttpBuffer);
+            in.reserve(kHttpBuffer);
+            char chunk[kHttpBuffer];
+            for (int sent = 0; sent < requestsPerConn; ) {
+                int batch = min(depth, requestsPerConn - sent);
+                out.clear();
+                for (int k=0;k<batch;++k) {
+                    string b = makeBody(id * requestsPerConn + sent + k);
+                    out += method + " " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: application/json\r\nContent-Length: " +
+                           to_string(b.size()) + "\r\n\r\n" + b;
+                }
+                auto start = chrono::steady_clock::now();
+                if (!sendAll(fd, out)) { errors += requestsPerConn - sent; break; }
+                int got = 0;
+                size_t pos = 0;
+                while (got < batch) {
+                    int rc = parseHttpMessage(in, pos, msg);
+                    if (rc > 0) {
+                        ++got;
+                        lat.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+                        if (msg.startLine.compare(0, 12, "HTTP/1.1 200") == 0) ++ok; else ++errors;
+                        continue;
+                    }
+                    ssize_t n = rc < 0 ? -1 : recv(fd, chunk, sizeof chunk, 0);
+                    if (n <= 0) break;
+                    in.append(chunk, n);
+                }
+                in.erase(0, pos);
+                if (got < batch) { errors += requestsPerConn - sent - got; break; }
+                sent += batch;
+            }
+        }
+        if (fd >= 0) ::close(fd);
+        lock_guard<mutex> lk(resultMutex);
+        res.ok += ok;
+        res.errors += errors;
+        res.latencyUs.insert(res.latencyUs.end(), lat.begin(), lat.end());
+    };
+    vector<thread> clients;
+    for (int c=0;c<max(1, connections);++c) clients.emplace_back(client, c);
+    for (auto &th : clients) th.join();
+    res.wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    return res;
+}
+
+// Request body maker for an endpoint, over a small pool of puzzles made up front
+function<string(int)> loadTestBodies(const string &endpoint, mt19937 &rng) {
+    if (endpoint == "generate") return [](int) { return string("{\"difficulty\":\"medium\"}"); };
+    auto pool = make_shared<vector<string>>();
+    for (int i=0;i<64;++i) {
+        Board p = endpoint == "count" ? randomClueSubset(rng, 24) : generatePuzzle(rng, 30);
+        pool->push_back("{\"puzzle\":\"" + boardToString(p) + "\"" + (endpoint == "count" ? ",\"limit\":1000}" : "}"));
+    }
+    return [pool](int i) { return (*pool)[i % pool->size()]; };
+}
+
+void printLoadTest(const string &endpoint, const LoadTestResult &r) {
+    cout << "  /" << endpoint << ": " << r.ok << " ok, " << r.errors << " errors, " << fixed << setprecision(0)
+         << (r.ok + r.errors) * 1000.0 / max(1e-9, r.wallMs) << " req/s\n";
+    cout.unsetf(ios::floatfield);
+    cout.precision(6);
+    printLatencyStats("latency", r.latencyUs);
+}
+
+// Cheap /solve traffic and a flood of expensive /count requests against one local server at once
+void benchOverload(const AdmissionConfig &cfg, PuzzleReservoir &reservoir, int solveConns, int countConns, int perConn,
+                   int depth, mt19937 &rng) {
+    unsigned hw = thread::hardware_concurrency();
+    HttpServer local(hw ? (int)hw : 4, &reservoir, cfg);
+    if (!local.start(0)) { cerr << "Couldn't start a local server.\n"; return; }
+    function<string(int)> solveBodies = loadTestBodies("solve", rng), countBodies = loadTestBodies("count", rng);
+    LoadTestResult solves, counts;
+    thread flood([&] { counts = runLoadTest(local.boundPort, countConns, perConn, depth, "POST", "/count", countBodies); });
+    solves = runLoadTest(local.boundPort, solveConns, perConn, depth, "POST", "/solve", solveBodies);
+    flood.join();
+    printLoadTest("solve", solves);
+    printLoadTest("count", counts);
+    cout << "  metrics: " << local.metricsJson() << '\n';
+}
+
+void httpMenu(PuzzleReservoir &reservoir, AdmissionConfig &admission, mt19937 &rng) {
+    cout << "HTTP API (POST /solve /count /rate, GET or POST /generate, GET /metrics). Action (serve/load/bench/policy/overload): ";
+    string act;
+    if (!(cin >> act)) return;
+    unsigned hw = thread::hardware_concurrency();
+    if (act == "serve") {
+        cout << "Port and worker threads (e.g. 8080 4): ";
+        int port, threads;
+        if (!(cin >> port >> threads)) return;
+        HttpServer server(threads, &reservoir, admission);
+        if (!server.start(port)) { cerr << "Couldn't listen on 127.0.0.1:" << port << "\n"; return; }
+        cout << "Serving on 127.0.0.1:" << server.boundPort << "; type 'stop' to shut down.\n";
+        string word;
+        while (cin >> word && word != "stop") {}
+        server.stop();
+        cout << "Served " << server.served << " requests.\n";
+    } else if (act == "load" || act == "bench") {
+        int port = 0;
+        if (act == "load") {
+            cout << "Server port: ";
+            if (!(cin >> port)) return;
+        }
+        cout << "Endpoint (solve/count/generate/rate), connections, requests per connection, pipeline depth (e.g. solve 4 500 8): ";
+        string endpoint;
+        int conns, perConn, depth;
+        if (!(cin >> endpoint >> conns >> perConn >> depth) || depth < 1) return;
+        HttpServer local(hw ? (int)hw : 4, &reservoir, admission);
+        if (act == "bench") {
+            if (!local.start(0)) { cerr << "Couldn't start a local server.\n"; return; }
+            port = local.boundPort;
+        }
+        LoadTestResult r = runLoadTest(port, conns, perConn, depth, endpoint == "generate" ? "GET" : "POST",
+                                       "/" + endpoint, loadTestBodies(endpoint, rng));
+        printLoadTest(endpoint, r);
+    } else if (act == "policy") {
+        cout << "Queue capacity per class " << admission.queueCap << ", per client " << admission.perClientCap << ", degrade "
+             << (admission.degrade ? "on" : "off") << ", deadline " << admission.deadlineMs << " ms, cost classes "
+             << (admission.separateClasses ? "on" : "off") << ".\n"
+             << "New values (capacity, per-client cap, degrade on/off, deadline ms, classes on/off; e.g. 256 64 on 50 on): ";
+        size_t cap, perClient;
+        string degrade, classes;
+        double deadline;
+        if (!(cin >> cap >> perClient >> degrade >> deadline >> classes)) return;
+        admission.queueCap = max<size_t>(1, cap);
+        admission.perClientCap = max<size_t>(1, perClient);
+        admission.degrade = (degrade == "on");
+        admission.deadlineMs = max(0.0, deadline);
+        admission.separateClasses = (classes == "on");
+    } else if (act == "overload") {
+        cout << "Solve connections, count connections, requests per connection, pipeline depth (e.g. 2 4 200 16): ";
+        int solveConns, countConns, perConn, depth;
+        if (!(cin >> solveConns >> countConns >> perConn >> depth) || depth < 1) return;
+        benchOverload(admission, reservoir, solveConns, countConns, perConn, depth, rng);
+    } else {
+        cout << "Unknown action.\n";
+    }
+}
+
+#endif // HAVE_HTTP_SERVER
+
+// ---- Self-check ----
+
+// Engines that must agree with the plain Solver, checked on corpora drawn from a fixed seed so a
+// run is repeatable. Option 23 and `--selftest` (exit status 1 on any mismatch) run every check.
+const unsigned kSelfCheckSeed = 20240611u;
+
+struct SelfCheck {
+    const char *name;
+    long long cases = 0, mismatches = 0;
+    explicit SelfCheck(const char *n) : name(n) {}
+};
+
+// Under-constrained grids: random clue subsets, and unique puzzles with a few clues taken out
+vector<Board> selfCheckCorpus(mt19937 &rng, int n) {
+    vector<Board> corpus;
+    for (int i=0;i<n;++i) {
+        if (i % 2) {
+            corpus.push_back(randomClueSubset(rng, 24 + (int)(rng() % 7)));
+        } else {
+            Board b = generatePuzzle(rng, 26);
+            for (int k=0;k<4;++k) { int c = rng() % 81; b[c/9][c%9] = 0; }
+            corpus.push_back(b);
+        }
+    }
+    return corpus;
+}
+
+// selfCheckCorpus(underConstrained) followed by `generated` generated puzzles: clue counts cycle
+// through minClues .. minClues+clueSpan-1, every singlesEvery-th is singles-only and every
+// changeEvery-th has one given changed to another digit, which often leaves no solution (0 = never)
+vector<Board> mixedCorpus(mt19937 &rng, int underConstrained, int generated, int minClues, int clueSpan,
+                          int singlesEvery, int changeEvery) {
+    vector<Board> corpus = selfCheckCorpus(rng, underConstrained);
+    for (int i=0;i<generated;++i) {
+        Board b = generatePuzzle(rng, minClues + i % clueSpan, singlesEvery && i % singlesEvery == 0);
+        int c = rng() % 81;
+        if (changeEvery && i % changeEvery == 1 && b[c/9][c%9]) b[c/9][c%9] = 1 + b[c/9][c%9] % 9;
+        corpus.push_back(b);
+    }
+    return corpus;
+}
+
+// A full grid with every cell of digits d1 and d2 emptied. The open cells form row/column cycles
+// that only the boxes (or jigsaw regions) tie together, which is where a wrong component split shows.
+Board twoDigitHoles(Board b, int d1, int d2) {
+    for (auto &row : b) for (int &v : row) if (v == d1 || v == d2) v = 0;
+    return b;
+}
+
+Board twoDigitHoles(const Board &b, mt19937 &rng) {
+    int d1 = 1 + rng() % 9;
+    return twoDigitHoles(b, d1, 1 + (d1 + rng() % 8) % 9);
+}
+
+// Plain search, the transposition table, and component decomposition (with and without the
+// table) must report the same count, saturated at the same limit. One table is shared by every
+// puzzle and by two other layouts, and memoizes subtrees down to two open cells, so stale or
+// cross-layout entries would show up as mismatches. verifyHash is on throughout, so a board or
+// candidate hash that drifts from a recomputation (say, a jigsaw peer left out) fails the case too.
+SelfCheck checkCounting(mt19937 &rng) {
+    SelfCheck out("plain == memo == decomposed");
+    TranspositionTable tt(16);
+    uint8_t region[81];
+    string err;
+    parseRegionMap(kSampleJigsaw, region, err);
+    RegionLayout jigsaw(region);
+    // classic boxes with (0,2) and (0,3) traded between the first two: emptying the two digits a
+    // full classic grid has there leaves the same candidates under both layouts, but not always
+    // the same count, so an entry keyed without the layout would be reused wrongly
+    memcpy(region, classicLayout.region, 81);
+    swap(region[2], region[3]);
+    RegionLayout traded(region);
+    vector<pair<Board, const RegionLayout *>> cases;
+    for (const Board &b : selfCheckCorpus(rng, 40)) cases.emplace_back(b, &classicLayout);
+    for (int i=0;i<20;++i) cases.emplace_back(twoDigitHoles(generateFullSolution(rng), rng), &classicLayout);
+    for (int i=0;i<20;++i) {
+        Board b = generateJigsawPuzzle(jigsaw, rng, 28);
+        for (int k=0;k<14;++k) { int c = rng() % 81; b[c/9][c%9] = 0; }
+        cases.emplace_back(b, &jigsaw);
+    }
+    for (int i=0;i<60;++i) cases.emplace_back(twoDigitHoles(generateJigsawPuzzle(jigsaw, rng, 81), rng), &jigsaw);
+    for (int i=0;i<20;++i) {
+        Board full = generateFullSolution(rng), b = twoDigitHoles(full, full[0][2], full[0][3]);
+        cases.emplace_back(b, &classicLayout);
+        cases.emplace_back(b, &traded);
+    }
+    Solver s;
+    s.ttMinOpen = 2;
+    s.verifyHash = true;
+    for (const auto &c : cases) {
+        s.layout = c.second;
+        for (long long limit : {2LL, 100LL, 5000LL}) {
+            long long count[4], staleBefore = s.hashMismatches;
+            for (int mode = 0; mode < 4; ++mode) { // plain, memo, decomposed, decomposed + memo
+                s.tt = (mode == 1 || mode == 3) ? &tt : nullptr;
+                if (!s.loadBoard(c.first)) { count[mode] = -1; continue; }
+                count[mode] = mode < 2 ? s.countSolutions((int)limit) : s.countSolutionsDecomposed(limit);
+            }
+            ++out.cases;
+            out.mismatches += !(count[0] == count[1] && count[0] == count[2] && count[0] == count[3])
+                || s.hashMismatches != staleBefore;
+        }
+    }
+    return out;
+}
+
+// The vectorized scan must pick the scalar loop's cell: the first with the fewest candidates, -1 on
+// a full board, -2 when some empty cell has none. Boards come from random legal placements, so
+// they include dead cells, plus solved grids with up to two cells emptied; half use the jigsaw
+// layout's shuffle indices.
+SelfCheck checkMrvScan(mt19937 &rng) {
+    SelfCheck out("vector MRV == scalar MRV");
+#if HAVE_SIMD_MRV
+    if (!kSimdMrv) return out;
+    uint8_t region[81];
+    string err;
+    parseRegionMap(kSampleJigsaw, region, err);
+    RegionLayout jigsaw(region);
+    Solver s;
+    for (int i=0;i<4000;++i) {
+        s.layout = (i % 2) ? &jigsaw : &classicLayout;
+        Board b{};
+        bool solved = i % 20 == 18; // classic layout (even i)
+        if (solved) {
+            b = generateFullSolution(rng);
+            for (int k = rng() % 3; k > 0; --k) { int c = rng() % 81; b[c/9][c%9] = 0; }
+        }
+        s.loadBoard(b);
+        for (int k = solved ? 0 : rng() % 64; k > 0; --k) {
+            int c = rng() % 81, m = b[c/9][c%9] ? 0 : s.candidatesMask(c/9, c%9);
+            if (!m) continue;
+            int options[9], n = 0;
+            for (; m; m &= m - 1) options[n++] = __builtin_ctz(m) + 1;
+            b[c/9][c%9] = options[rng() % n];
+            s.loadBoard(b);
+        }
+        int expect = -1, bestCount = 10;
+        for (int c=0;c<81 && expect != -2;++c) {
+            if (b[c/9][c%9]) continue;
+            int cnt = __builtin_popcount(s.candidatesMask(c/9, c%9));
+            if (cnt == 0) expect = -2;
+            else if (cnt < bestCount) { bestCount = cnt; expect = c; }
+        }
+        ++out.cases;
+        out.mismatches += simdMrvScan(s.board, s.rowMask.data(), s.colMask.data(), s.blockMask.data(), s.layout->mrv) != expect;
+    }
+#else
+    (void)rng;
+#endif
+    return out;
+}
+
+// Lane batches must report Solver's count (limit 2) and, for unique puzzles, its solution. The
+// corpus mixes unique puzzles of every difficulty, under-constrained grids, puzzles with a given
+// changed (often no solution) and repeated givens, in a count that leaves a partial last batch.
+SelfCheck checkLaneBatch(mt19937 &rng) {
+    SelfCheck out("lane batch == Solver");
+    vector<Board> corpus = mixedCorpus(rng, 150, 450, 24, 15, 3, 5);
+    for (size_t i = 150 + 2; i < corpus.size(); i += 25) corpus[i][0][0] = corpus[i][0][1] = 1 + rng() % 9; // repeat a given
+    vector<int> counts;
+    vector<Board> solutions;
+    batchCountSolutions(corpus, 2, counts, solutions);
+    Solver s;
+    for (size_t i=0;i<corpus.size();++i) {
+        int expect = s.loadBoard(corpus[i]) ? s.countSolutions(2) : 0;
+        ++out.cases;
+        out.mismatches += counts[i] != expect || (expect == 1 && solutions[i] != s.board);
+    }
+    return out;
+}
+
+// The bitboard singles solver must fill exactly the puzzles the rater's singles pass solves, with
+// the same (unique) solution as Solver. Puzzles cover singles-only generation, every clue count
+// from 22 to 36, under-constrained grids and changed givens.
+SelfCheck checkSingles(mt19937 &rng) {
+    SelfCheck out("singlesSolvable == rater singles");
+    vector<Board> corpus = mixedCorpus(rng, 60, 540, 22, 15, 4, 7);
+    Solver s;
+    for (const Board &b : corpus) {
+        SinglesSolver singles;
+        bool filled = singles.load(b) && singles.solve();
+        bool mismatch = filled != rateTechniques(b, Technique::HiddenSingle).solved;
+        if (filled && !mismatch) mismatch = !s.loadBoard(b) || s.countSolutions(2) != 1 || s.board != singles.board;
+        ++out.cases;
+        out.mismatches += mismatch;
+    }
+    return out;
+}
+
+// Copy-on-branch counting over CompactState must match Solver, with and without singles
+// propagation, at limits 2 and 1000; for unique puzzles the solution must match too
+SelfCheck checkCopySolver(mt19937 &rng) {
+    SelfCheck out("CopySolver == Solver");
+    vector<Board> corpus = mixedCorpus(rng, 120, 80, 24, 10, 0, 4);
+    Solver s;
+    CopySolver copy;
+    for (const Board &b : corpus) {
+        for (int limit : {2, 1000}) {
+            int expect = s.loadBoard(b) ? s.countSolutions(limit) : 0;
+            for (int prop = 0; prop < 2; ++prop) {
+                copy.propagate = prop;
+                int got = copy.loadBoard(b) ? copy.countSolutions(limit) : 0;
+                ++out.cases;
+                out.mismatches += got != expect || (expect == 1 && copy.board != s.board);
+            }
+        }
+    }
+    return out;
+}
+
+// Killer over a full grid whose rules hold as many cells as possible: the cells of one digit are
+// single-cell cages, so each unit has one cage inside it and a remainder of 8, and the rest are
+// paired (a leftover joins a pair) so that no other cage lies inside a unit. That is 81 caged
+// cells plus 27 remainders of 8, 297 rule cells in all.
+KillerPuzzle scatteredKiller(const Board &full, mt19937 &rng) {
+    KillerPuzzle p;
+    int single = 1 + rng() % 9;
+    vector<int> rest;
+    for (int i=0;i<81;++i) {
+        if (full[i/9][i%9] == single) p.cages.push_back({single, {i}});
+        else rest.push_back(i);
+    }
+    shuffle(rest.begin(), rest.end(), rng);
+    auto digit = [&](int i) { return full[i/9][i%9]; };
+    auto apart = [&](int a, int b) {
+        return a/9 != b/9 && a%9 != b%9 && blockIndex(a/9, a%9) != blockIndex(b/9, b%9) && digit(a) != digit(b);
+    };
+    vector<bool> used(81, false);
+    for (size_t k=0;k<rest.size();++k) {
+        int a = rest[k];
+        if (used[a]) continue;
+        used[a] = true;
+        auto partner = find_if(rest.begin() + k + 1, rest.end(), [&](int b) { return !used[b] && apart(a, b); });
+        if (partner != rest.end()) {
+            used[*partner] = true;
+            p.cages.push_back({digit(a) + digit(*partner), {a, *partner}});
+            continue;
+        }
+        for (Cage &cg : p.cages) {
+            if (cg.cells.size() < 2 || cg.cells.size() >= 9) continue;
+            if (any_of(cg.cells.begin(), cg.cells.end(), [&](int i) { return digit(i) == digit(a); })) continue;
+            cg.cells.push_back(a);
+            cg.sum += digit(a);
+            break;
+        }
+    }
+    return p;
+}
+
+// Killer counts: generated puzzles must stay unique, and the scattered-cage puzzles (more rule
+// cells than a byte can index) must have a solution that fits every cage
+SelfCheck checkKiller(mt19937 &rng) {
+    SelfCheck out("killer rules on large rule sets");
+    KillerSolver s;
+    for (int i=0;i<10;++i) {
+        ++out.cases;
+        out.mismatches += !s.load(generateKiller(rng)) || s.countSolutions(2) != 1;
+    }
+    for (int i=0;i<40;++i) {
+        KillerPuzzle p = scatteredKiller(generateFullSolution(rng), rng);
+        bool ok = s.load(p) && s.countSolutions(2) >= 1;
+        for (const Cage &cg : p.cages) {
+            if (!ok) break;
+            int sum = 0;
+            for (int c : cg.cells) sum += s.found[0][c/9][c%9];
+            ok = sum == cg.sum;
+        }
+        ++out.cases;
+        out.mismatches += !ok;
+    }
+    return out;
+}
+
+bool runSelfCheck(unsigned seed) {
+    mt19937 rng(seed);
+    vector<SelfCheck> checks;
+    checks.push_back(checkCounting(rng));
+    checks.push_back(checkMrvScan(rng));
+    checks.push_back(checkLaneBatch(rng));
+    checks.push_back(checkSingles(rng));
+    checks.push_back(checkCopySolver(rng));
+    checks.push_back(checkKiller(rng));
+    bool ok = true;
+    for (const SelfCheck &c : checks) {
+        cout << "  " << setw(32) << left << c.name << right << setw(6) << c.cases << " cases, " << c.mismatches << " mismatches\n";
+        ok = ok && c.mismatches == 0;
+    }
+    cout << (ok ? "All checks passed.\n" : "Self-check FAILED.\n");
+    return ok;
+}
+
+void menu() {
+    cout << "AI-Powered Sudoku - Solver & Generator\n";
+    cout << "Options:\n";
+    cout << "  1 - Generate puzzle (easy/medium/hard or specify number of clues e.g. 30)\n";
+    cout << "  2 - Solve puzzle (enter 81 characters: digits or . for blanks)\n";
+    cout << "  3 - Learned digit ordering (train, load, toggle, benchmark)\n";
+    cout << "  4 - Stochastic solve for large grids (e.g. 25x25; one solution, no uniqueness check)\n";
+    cout << "  5 - Adaptive engine selection (calibrate, toggle, benchmark)\n";
+    cout << "  6 - Portfolio racing of several engines (toggle, tail-latency benchmark)\n";
+    cout << "  7 - Randomized restarts for one-solution solves (toggle, benchmark)\n";
+    cout << "  8 - Count solutions of a puzzle (plain, transposition table, component decomposition)\n";
+    cout << "  9 - Benchmark incremental Zobrist board hashing\n";
+    cout << " 10 - Sample solutions and undetermined cells of a non-unique puzzle\n";
+    cout << " 11 - Suggest extra clues that make a non-unique puzzle unique\n";
+    cout << " 12 - Benchmark trail undo vs copy-on-branch (full snapshot and compact state)\n";
+    cout << " 13 - Rated generation (threaded generate/filter/rate pipeline, technique rating)\n";
+    cout << " 14 - HTTP/JSON API on localhost (serve, load test)\n";
+    cout << " 15 - Pre-generated puzzle reservoir with background refill\n";
+    cout << " 16 - Uniqueness check policy for option 2 (full, skip, defer to background, auto by latency budget)\n";
+    cout << " 17 - Packed session store (memory per session, move/hint benchmark)\n";
+    cout << " 18 - Benchmark vectorized MRV scan vs scalar loop\n";
+    cout << " 19 - Benchmark lane-parallel batch propagation (16 puzzles per vector)\n";
+    cout << " 20 - Jigsaw (irregular region) puzzles: solve, generate, benchmark\n";
+    cout << " 21 - Killer sudoku (cage sums): solve, generate, benchmark\n";
+    cout << " 22 - Samurai (five overlapping grids): solve, generate, benchmark\n";
+    cout << " 23 - Self-check: engines that must agree with the plain solver, on a fixed-seed corpus\n";
+    cout << "  0 - Exit\n";
+}
+
+int main(int argc, char **argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+    if (argc > 1 && string(argv[1]) == "--selftest") return runSelfCheck(kSelfCheckSeed) ? 0 : 1;
+    mt19937 rng((unsigned)chrono::high_resolution_clock::now().time_since_epoch().count());
+    ValueModel valueModel;
+    bool useValueModel = valueModel.loadFromFile("value_model.txt");
+    EngineSelector engineSelector;
+    if (ifstream("engine_select.txt") && !engineSelector.loadFromFile("engine_select.txt"))
+        cerr << "Couldn't read engine_select.txt; using the default engine selection.\n";
+    bool useEngineSelector = true;
+    bool usePortfolio = false;
+    bool useRestarts = false;
+    long long restartBase = 100;
+    TranspositionTable countTable(64);
+    PuzzleReservoir reservoir("reservoir.txt");
+#if HAVE_HTTP_SERVER
+    AdmissionConfig admission;
+#endif
+    CheckPolicy solvePolicy = CheckPolicy::Full;
+    double solveBudgetMs = 5;
+    DeferredChecks deferredChecks(1);
+    vector<long long> pendingChecks; // option 2 checks not reported yet
+
+    while (true) {
+        for (auto it = pendingChecks.begin(); it != pendingChecks.end(); ) {
+            int cnt = deferredChecks.poll(*it);
+            if (cnt == DeferredChecks::kPending) { ++it; continue; }
+            cout << "Uniqueness check #" << *it << ": "
+                 << (cnt == 1 ? "unique" : cnt == 0 ? "no solution" : "multiple solutions") << '\n';
+            it = pendingChecks.erase(it);
+        }
+        menu();
+        cout << "Choose option: ";
+        int opt;
+        if (!(cin >> opt)) return 0;
+        if (opt == 0) return 0;
+        if (opt == 1) {
             cout << "Enter difficulty (easy/medium/hard) or number of clues (17-81). Default 'medium': ";
             string diff;
             if (!(cin >> diff)) diff = "medium";
             int clues = difficultyToClues(diff);
-            cout << "Generating puzzle with target ~" << clues << " clues (unique-solutions enforced)...\n";
-            Board p = generatePuzzle(rng, clues);
+            string lower = diff;
+            for (auto &ch : lower) ch = tolower((unsigned char)ch);
+            bool singlesOnly = (lower == "easy");
+            cout << "Generating puzzle with target ~" << clues << " clues (unique-solutions enforced"
+                 << (singlesOnly ? ", solvable by singles alone" : "") << ")...\n";
+            Board p = takeOrGenerate(&reservoir, lower, rng); // same generatePuzzle call when the reservoir is off
             printBoard(p);
             cout << "Solution? (y/n): ";
             char ans; cin >> ans;
             if (ans == 'y' || ans == 'Y') {
-                Solver s;
+                PooledSolver pooled;
+                Solver &s = *pooled;
+                if (useValueModel) s.model = &valueModel;
                 if (!s.loadBoard(p)) {
                     cerr << "Invalid puzzle loaded.\n";
                 } else {
-                    s.solveOne();
+                    if (useRestarts) s.solveOneWithRestarts(rng, restartBase);
+                    else s.solveOne();
                     cout << "Solution:\n";
                     printBoard(s.board);
                 }
@@ -317,40 +5775,110 @@ int main() {
             cout << "Enter puzzle as single line (81 chars) or 9 lines of 9 chars. Use digits 1-9 and . for blank.\n";
             string line;
             getline(cin, line); // consume rest of current line
-            string input;
-            while ((int)input.size() < 81) {
-                if (!getline(cin, line)) break;
-                bool onlyws = true;
-                for (char ch : line) if (!isspace((unsigned char)ch)) onlyws = false;
-                if (onlyws) continue;
-                input += line;
-            }
-            string cleaned;
-            for (char ch : input) if (!isspace((unsigned char)ch)) cleaned.push_back(ch);
             Board b;
-            if (!parseBoard(cleaned, b)) {
+            if (!parseBoard(readGridInput(9), b)) {
                 cerr << "Couldn't parse board. Ensure 81 characters (digits or .)\n";
                 continue;
             }
             cout << "Input puzzle:\n";
             printBoard(b);
-            Solver solver;
+            PooledSolver pooled;
+            Solver &solver = *pooled;
+            if (useValueModel) solver.model = &valueModel;
             if (!solver.loadBoard(b)) {
                 cerr << "Puzzle invalid (contradiction detected).\n";
                 continue;
             }
-            int sols = solver.countSolutions(2);
+            if (useEngineSelector) {
+                Engine e = engineSelector.select(solver.features());
+                if (e != Engine::Learned || useValueModel) solver.useEngine(e, &valueModel);
+            }
+            int sols;
+            bool checked = true;
+            long long checkId = 0;
+            if (usePortfolio) {
+                PortfolioResult race = portfolioSolve(b, 2, useValueModel ? &valueModel : nullptr);
+                sols = race.count;
+                solver.board = race.solution;
+            } else {
+                SolveOutcome r = solveWithPolicy(solver, b, solvePolicy, solveBudgetMs, &deferredChecks);
+                sols = r.count;
+                checked = r.checked;
+                checkId = r.checkId;
+                solver.board = r.solution;
+            }
             if (sols == 0) {
                 cout << "No solutions exist for this puzzle.\n";
+            } else if (!checked) {
+                if (checkId) cout << "Solution found; uniqueness check #" << checkId << " is running in the background:\n";
+                else cout << "Solution found (uniqueness not checked):\n";
+                printBoard(solver.board);
+                if (checkId) pendingChecks.push_back(checkId);
             } else if (sols > 1) {
                 cout << "Multiple (" << sols << ") solutions found (<=2 checked). Solver will produce one solution:\n";
-                solver.solveOne();
                 printBoard(solver.board);
             } else {
                 cout << "Unique solution found:\n";
-                solver.solveOne();
                 printBoard(solver.board);
             }
+        } else if (opt == 3) {
+            valueModelMenu(valueModel, useValueModel, rng);
+        } else if (opt == 4) {
+            stochasticSolveMenu(rng);
+        } else if (opt == 5) {
+            engineSelectMenu(engineSelector, useEngineSelector, valueModel, rng);
+        } else if (opt == 6) {
+            portfolioMenu(usePortfolio, engineSelector, useValueModel ? &valueModel : nullptr, rng);
+        } else if (opt == 7) {
+            restartMenu(useRestarts, restartBase, rng);
+        } else if (opt == 8) {
+            countMenu(countTable, rng);
+        } else if (opt == 9) {
+            benchHashing(promptCorpus(rng));
+        } else if (opt == 10) {
+            sampleMenu(rng);
+        } else if (opt == 11) {
+            suggestMenu(rng);
+        } else if (opt == 12) {
+            benchTrail(promptCorpus(rng));
+        } else if (opt == 13) {
+            pipelineMenu(rng);
+        } else if (opt == 14) {
+#if HAVE_HTTP_SERVER
+            httpMenu(reservoir, admission, rng);
+#else
+            cout << "The HTTP server needs POSIX sockets; not available in this build.\n";
+#endif
+        } else if (opt == 15) {
+            reservoirMenu(reservoir, rng);
+        } else if (opt == 16) {
+            cout << "Uniqueness check policy is " << checkPolicyName(solvePolicy) << " (auto budget " << solveBudgetMs
+                 << " ms). New policy (full/skip/defer/auto): ";
+            string name;
+            CheckPolicy p;
+            if (!(cin >> name) || !parseCheckPolicy(name, p)) { cout << "Unknown policy.\n"; continue; }
+            solvePolicy = p;
+            if (p == CheckPolicy::Auto) {
+                cout << "Latency budget in ms: ";
+                double ms;
+                if (cin >> ms && ms >= 0) solveBudgetMs = ms;
+            }
+        } else if (opt == 17) {
+            cout << "Sessions and operations (e.g. 10000 100000): ";
+            int sessions, moves;
+            if (cin >> sessions >> moves && sessions > 0 && moves >= 0) benchSessions(sessions, moves, rng);
+        } else if (opt == 18) {
+            benchMrvScan(promptCorpus(rng));
+        } else if (opt == 19) {
+            benchBatch(promptCorpus(rng));
+        } else if (opt == 20) {
+            jigsawMenu(rng);
+        } else if (opt == 21) {
+            killerMenu(rng);
+        } else if (opt == 22) {
+            samuraiMenu(rng);
+        } else if (opt == 23) {
+            runSelfCheck(kSelfCheckSeed);
         } else {
             cout << "Unknown option.\n";
         }